@@ -0,0 +1,901 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+//
+// SYNOPSIS:
+//     bench_image_merge [OPTIONS]
+//
+// DESCRIPTION
+//     Generates a deterministic synthetic corpus of jpeg and png files, and
+//     runs benchmarks of the image_merge processing stages:
+//     - decode:    read_jpeg_file / read_png_file, for each corpus file; the
+//                  corpus has rgb, progressive and gray jpeg files, and rgba,
+//                  gray, palette and 16 bit rgba png files
+//     - resample:  upload a source image to a texture and render it scaled
+//                  into a pane, as done by draw_images
+//     - composite: render N cached pane textures to the window
+//     - encode:    write_jpeg_file / write_png_file
+//     - e2e:       run 'image_merge -z' with 1, 10, 100 and 1000 inputs
+//
+//     The corpus files are deterministic, so files that already exist in the
+//     corpus directory are reused rather than generated again.
+//
+//     Each benchmark is repeated, and the min, median and p99 times are
+//     reported along with the throughput in megapixels or images per second.
+//     The output format is stable so that it can be compared run-to-run.
+//
+//     The resample and composite benchmarks require a display; to run them
+//     without a display set SDL_VIDEODRIVER=dummy. The e2e benchmark runs
+//     the image_merge program, which is expected to be in the current directory.
+//
+// OPTIONS
+//     -r REPS     : number of repetitions of each benchmark, default 5
+//     -d DIR      : directory for the generated corpus, default /tmp/bench_image_merge
+//     -x PATH     : pathname of the image_merge program, default ./image_merge
+//     -j FILE     : also write the results to FILE in json format
+//     -q          : quick, skip the largest image sizes and the 1000 input e2e
+//     -S          : skip the resample and composite benchmarks, which use sdl
+//     -E          : skip the e2e benchmark
+//     -l MS       : latency check, exit with status 1 if the median time of the
+//                   e2e benchmark with LATENCY_CHECK_INPUTS (10) inputs exceeds MS;
+//                   this is intended for use as a regression test of batch mode,
+//                   see 'make bench-check'
+//     -h          : help
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <png.h>
+
+#include "util_sdl.h"
+#include "util_jpeg.h"
+#include "util_png.h"
+#include "util_misc.h"
+
+//
+// defines
+//
+
+#define MAX_RESULT        200
+#define MAX_SAMPLE        1000
+#define MAX_E2E_INPUTS    1000
+#define MAX_CORPUS_DIR    1000
+
+#define CORPUS_JPEG_RGB_BASELINE     0
+#define CORPUS_JPEG_RGB_PROGRESSIVE  1
+#define CORPUS_JPEG_GRAY_BASELINE    2
+#define CORPUS_PNG_RGBA              3
+#define CORPUS_PNG_GRAY              4
+#define CORPUS_PNG_PALETTE           5
+#define CORPUS_PNG_RGBA16            6
+#define MAX_CORPUS_TYPE              7
+
+// the e2e inputs cycle through just the jpeg and the png rgba types, 
+// so that the e2e times are comparable with prior results
+#define MAX_E2E_CORPUS_TYPE          4
+
+#define CORPUS_TYPE_STR(x) \
+    ((x) == CORPUS_JPEG_RGB_BASELINE    ? "jpeg_rgb_baseline"    : \
+     (x) == CORPUS_JPEG_RGB_PROGRESSIVE ? "jpeg_rgb_progressive" : \
+     (x) == CORPUS_JPEG_GRAY_BASELINE   ? "jpeg_gray_baseline"   : \
+     (x) == CORPUS_PNG_RGBA             ? "png_rgba"             : \
+     (x) == CORPUS_PNG_GRAY             ? "png_gray"             : \
+     (x) == CORPUS_PNG_PALETTE          ? "png_palette"          : \
+     (x) == CORPUS_PNG_RGBA16           ? "png_rgba16"             \
+                                        : "????")
+
+#define CORPUS_TYPE_IS_PNG(x) ((x) >= CORPUS_PNG_RGBA)
+#define CORPUS_TYPE_EXT(x) (CORPUS_TYPE_IS_PNG(x) ? "png" : "jpg")
+
+#define JPEG_QUALITY 85
+
+#define LATENCY_CHECK_INPUTS 10
+
+//
+// typedefs
+//
+
+typedef struct {
+    int32_t w, h;
+    bool    large;
+} size_tbl_t;
+
+typedef struct {
+    char    name[100];
+    int32_t reps;
+    double  min_ms;
+    double  median_ms;
+    double  p99_ms;
+    double  throughput;
+    char  * throughput_units;
+} result_t;
+
+//
+// variables
+//
+
+static const size_tbl_t size_tbl[] = {
+        {  320,  240, false },
+        { 1024,  768, false },
+        { 1920, 1080, false },
+        { 4000, 3000, true  }, };
+#define MAX_SIZE_TBL (sizeof(size_tbl) / sizeof(size_tbl[0]))
+
+static const int32_t e2e_inputs_tbl[] = { 1, 10, 100, 1000 };
+#define MAX_E2E_INPUTS_TBL (sizeof(e2e_inputs_tbl) / sizeof(e2e_inputs_tbl[0]))
+
+static int32_t   reps = 5;
+static char      corpus_dir[MAX_CORPUS_DIR] = "/tmp/bench_image_merge";
+static char      image_merge_path[PATH_MAX] = "./image_merge";
+static char    * json_filename;
+static bool      quick;
+static bool      skip_sdl;
+static bool      skip_e2e;
+static double    latency_check_ms;
+static double    latency_ms = -1;
+
+static result_t  result[MAX_RESULT];
+static int32_t   max_result;
+
+//
+// prototypes
+//
+
+static void usage(void);
+static uint8_t * synthetic_pixels(int32_t w, int32_t h, uint32_t seed);
+static void write_corpus_file(char * file_name, int32_t type, uint8_t * pixels, int32_t w, int32_t h);
+static void write_corpus_png_file(char * file_name, int32_t type, uint8_t * pixels, int32_t w, int32_t h);
+static void generate_corpus(void);
+static void bench_decode(void);
+static void bench_encode(void);
+static void bench_resample(void);
+static void bench_composite(void);
+static void bench_e2e(void);
+static void add_result(char * name, uint64_t * sample_us, int32_t max_sample,
+                       double work, char * throughput_units);
+static void print_results(void);
+static void write_json(void);
+
+// -----------------  MAIN  ---------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    // get options
+    while (true) {
+        int32_t opt_char = getopt(argc, argv, "r:d:x:j:qSEl:h");
+        if (opt_char == -1) {
+            break;
+        }
+        switch (opt_char) {
+        case 'r':
+            if (sscanf(optarg, "%d", &reps) != 1 || reps < 1 || reps > MAX_SAMPLE) {
+                FATAL("invalid '-r %s'\n", optarg);
+            }
+            break;
+        case 'd':
+            if (snprintf(corpus_dir, sizeof(corpus_dir), "%s", optarg) >= (int)sizeof(corpus_dir)) {
+                FATAL("invalid '-d %s'\n", optarg);
+            }
+            break;
+        case 'x':
+            if (snprintf(image_merge_path, sizeof(image_merge_path), "%s", optarg) >= (int)sizeof(image_merge_path)) {
+                FATAL("invalid '-x %s'\n", optarg);
+            }
+            break;
+        case 'j':
+            json_filename = optarg;
+            break;
+        case 'q':
+            quick = true;
+            break;
+        case 'S':
+            skip_sdl = true;
+            break;
+        case 'E':
+            skip_e2e = true;
+            break;
+        case 'l':
+            if (sscanf(optarg, "%lf", &latency_check_ms) != 1 || latency_check_ms <= 0) {
+                FATAL("invalid '-l %s'\n", optarg);
+            }
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            exit(1);
+            break;
+        }
+    }
+
+    // generate the corpus, and
+    // run the benchmarks
+    generate_corpus();
+    bench_decode();
+    bench_encode();
+    if (!skip_sdl) {
+        if (sdl_init(1280, 960, NULL, NULL) == 0) {
+            bench_resample();
+            bench_composite();
+        } else {
+            WARN("sdl_init failed, skipping resample and composite benchmarks\n");
+        }
+    }
+    if (!skip_e2e) {
+        bench_e2e();
+    }
+
+    // report the results
+    print_results();
+    if (json_filename) {
+        write_json();
+    }
+
+    // if requested, check the e2e latency
+    if (latency_check_ms > 0) {
+        if (latency_ms < 0) {
+            ERROR("latency check failed, the e2e %d inputs benchmark did not run\n", LATENCY_CHECK_INPUTS);
+            return 1;
+        }
+        if (latency_ms > latency_check_ms) {
+            ERROR("latency check failed, e2e %d inputs median %.3f ms exceeds %.3f ms\n",
+                  LATENCY_CHECK_INPUTS, latency_ms, latency_check_ms);
+            return 1;
+        }
+        INFO("latency check passed, e2e %d inputs median %.3f ms is within %.3f ms\n",
+             LATENCY_CHECK_INPUTS, latency_ms, latency_check_ms);
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("\
+SYNOPSIS: \n\
+    bench_image_merge [OPTIONS]\n\
+\n\
+DESCRIPTION\n\
+    Generates a deterministic synthetic corpus of jpeg and png files, and\n\
+    runs the decode, resample, composite, encode and end-to-end (e2e) \n\
+    benchmarks. The min, median and p99 times are reported along with the \n\
+    throughput. To run the resample and composite benchmarks without a \n\
+    display set SDL_VIDEODRIVER=dummy.\n\
+\n\
+OPTIONS\n\
+    -r REPS     : number of repetitions of each benchmark, default 5\n\
+    -d DIR      : directory for the generated corpus, default /tmp/bench_image_merge\n\
+    -x PATH     : pathname of the image_merge program, default ./image_merge\n\
+    -j FILE     : also write the results to FILE in json format\n\
+    -q          : quick, skip the largest image sizes and the 1000 input e2e\n\
+    -S          : skip the resample and composite benchmarks, which use sdl\n\
+    -E          : skip the e2e benchmark\n\
+    -l MS       : latency check, exit with status 1 if the median time of the\n\
+                  e2e benchmark with 10 inputs exceeds MS\n\
+    -h          : help\n\
+");
+}
+
+// -----------------  SYNTHETIC CORPUS  ---------------------------------------------------------
+
+// returns pixels in SDL_PIXELFORMAT_ABGR8888 format, the caller must free;
+// the image is a smooth gradient overlaid with blocks of varying color and
+// a small amount of noise, so that it compresses similar to a photograph;
+// the same seed always produces the same image
+static uint8_t * synthetic_pixels(int32_t w, int32_t h, uint32_t seed)
+{
+    uint8_t * pixels, * p;
+    uint32_t  rnd = seed * 2654435761u + 1;
+    int32_t   x, y, block_r, block_g, block_b;
+
+    #define XORSHIFT(v) ((v) ^= (v) << 13, (v) ^= (v) >> 17, (v) ^= (v) << 5, (v))
+    #define CLIP(v) ((v) < 0 ? 0 : (v) > 255 ? 255 : (v))
+
+    pixels = malloc((size_t)w * h * BYTES_PER_PIXEL);
+    if (pixels == NULL) {
+        FATAL("allocate pixels %dx%d failed\n", w, h);
+    }
+
+    p = pixels;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            uint32_t block = ((y / 64) * 7919 + (x / 64)) * 2246822519u + seed;
+            int32_t  noise = (int32_t)(XORSHIFT(rnd) & 15) - 8;
+            block_r = (block >> 0) & 63;
+            block_g = (block >> 8) & 63;
+            block_b = (block >> 16) & 63;
+            p[0] = CLIP(255 * x / w * 3 / 4 + block_r + noise);
+            p[1] = CLIP(255 * y / h * 3 / 4 + block_g + noise);
+            p[2] = CLIP(255 * (x + y) / (w + h) * 3 / 4 + block_b + noise);
+            p[3] = 255;
+            p += BYTES_PER_PIXEL;
+        }
+    }
+    return pixels;
+}
+
+// the corpus files are written using libjpeg directly, rather than with
+// write_jpeg_file, because write_jpeg_file supports just baseline rgb
+static void write_corpus_file(char * file_name, int32_t type, uint8_t * pixels, int32_t w, int32_t h)
+{
+    struct jpeg_compress_struct   cinfo;
+    struct jpeg_error_mgr         err_mgr;
+    FILE                        * fp;
+    JSAMPLE                     * row;
+    int32_t                       x, components;
+
+    if (type == CORPUS_PNG_RGBA) {
+        if (write_png_file(file_name, pixels, w, h, NULL, 0) != 0) {
+            FATAL("write_png_file %s failed\n", file_name);
+        }
+        return;
+    }
+    if (CORPUS_TYPE_IS_PNG(type)) {
+        write_corpus_png_file(file_name, type, pixels, w, h);
+        return;
+    }
+
+    fp = fopen(file_name, "wb");
+    if (fp == NULL) {
+        FATAL("fopen %s, %s\n", file_name, strerror(errno));
+    }
+
+    // the default libjpeg error handler exits the program on error
+    cinfo.err = jpeg_std_error(&err_mgr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, fp);
+
+    components = (type == CORPUS_JPEG_GRAY_BASELINE ? 1 : 3);
+    cinfo.image_width      = w;
+    cinfo.image_height     = h;
+    cinfo.input_components = components;
+    cinfo.in_color_space   = (components == 1 ? JCS_GRAYSCALE : JCS_RGB);
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+    if (type == CORPUS_JPEG_RGB_PROGRESSIVE) {
+        jpeg_simple_progression(&cinfo);
+    }
+    jpeg_start_compress(&cinfo, TRUE);
+
+    row = malloc(w * components);
+    if (row == NULL) {
+        FATAL("allocate row %dx%d failed\n", w, components);
+    }
+    while (cinfo.next_scanline < cinfo.image_height) {
+        uint8_t * inp = pixels + (size_t)cinfo.next_scanline * w * BYTES_PER_PIXEL;
+        JSAMPROW  scanline[1] = { row };
+        for (x = 0; x < w; x++) {
+            if (components == 1) {
+                row[x] = (inp[0] * 77 + inp[1] * 150 + inp[2] * 29) >> 8;
+            } else {
+                row[3*x+0] = inp[0];
+                row[3*x+1] = inp[1];
+                row[3*x+2] = inp[2];
+            }
+            inp += BYTES_PER_PIXEL;
+        }
+        jpeg_write_scanlines(&cinfo, scanline, 1);
+    }
+    free(row);
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    fclose(fp);
+}
+
+// the gray, palette and 16 bit png corpus files are written using libpng directly, 
+// because write_png_file writes just 8 bit rgba; the palette is a 6x6x6 color cube
+static void write_corpus_png_file(char * file_name, int32_t type, uint8_t * pixels, int32_t w, int32_t h)
+{
+    png_structp   png_ptr;
+    png_infop     png_info;
+    png_color     palette[216];
+    FILE        * fp;
+    uint8_t     * row, * inp, * outp;
+    int32_t       x, y, c, color_type, depth, bytes_per_pixel;
+
+    switch (type) {
+    case CORPUS_PNG_GRAY:    color_type = PNG_COLOR_TYPE_GRAY;      depth = 8;  bytes_per_pixel = 1; break;
+    case CORPUS_PNG_PALETTE: color_type = PNG_COLOR_TYPE_PALETTE;   depth = 8;  bytes_per_pixel = 1; break;
+    case CORPUS_PNG_RGBA16:  color_type = PNG_COLOR_TYPE_RGB_ALPHA; depth = 16; bytes_per_pixel = 8; break;
+    default: FATAL("corpus type %d is not a png type\n", type);
+    }
+
+    fp = fopen(file_name, "wb");
+    if (fp == NULL) {
+        FATAL("fopen %s, %s\n", file_name, strerror(errno));
+    }
+    row = malloc((size_t)w * bytes_per_pixel);
+    if (row == NULL) {
+        FATAL("allocate row %dx%d failed\n", w, bytes_per_pixel);
+    }
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_info = (png_ptr ? png_create_info_struct(png_ptr) : NULL);
+    if (png_info == NULL) {
+        FATAL("create png write struct for %s failed\n", file_name);
+    }
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        FATAL("write %s failed\n", file_name);
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_IHDR(png_ptr, png_info, w, h, depth, color_type, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    if (type == CORPUS_PNG_PALETTE) {
+        for (c = 0; c < 216; c++) {
+            palette[c].red   = (c / 36) * 51;
+            palette[c].green = (c / 6 % 6) * 51;
+            palette[c].blue  = (c % 6) * 51;
+        }
+        png_set_PLTE(png_ptr, png_info, palette, 216);
+    }
+    png_write_info(png_ptr, png_info);
+
+    for (y = 0; y < h; y++) {
+        inp = pixels + (size_t)y * w * BYTES_PER_PIXEL;
+        outp = row;
+        for (x = 0; x < w; x++) {
+            if (type == CORPUS_PNG_GRAY) {
+                *outp++ = (inp[0] * 77 + inp[1] * 150 + inp[2] * 29) >> 8;
+            } else if (type == CORPUS_PNG_PALETTE) {
+                *outp++ = (inp[0] + 25) / 51 * 36 + (inp[1] + 25) / 51 * 6 + (inp[2] + 25) / 51;
+            } else {
+                // 16 bit samples are big endian; the low byte adds detail 
+                // that is not in the 8 bit pixels
+                for (c = 0; c < 4; c++) {
+                    *outp++ = inp[c];
+                    *outp++ = (c == 3 ? 255 : (x * 7 + y * 13 + c) & 255);
+                }
+            }
+            inp += BYTES_PER_PIXEL;
+        }
+        png_write_row(png_ptr, row);
+    }
+    png_write_end(png_ptr, NULL);
+
+    png_destroy_write_struct(&png_ptr, &png_info);
+    free(row);
+    fclose(fp);
+}
+
+static void generate_corpus(void)
+{
+    char      file_name[PATH_MAX];
+    uint8_t * pixels;
+    int32_t   i, type;
+    uint64_t  start = microsec_timer();
+
+    // create the corpus directories
+    sprintf(file_name, "%s/e2e", corpus_dir);
+    if ((mkdir(corpus_dir, 0755) != 0 && errno != EEXIST) ||
+        (mkdir(file_name, 0755) != 0 && errno != EEXIST))
+    {
+        FATAL("mkdir %s, %s\n", file_name, strerror(errno));
+    }
+
+    // generate the decode benchmark files, one per size and type
+    for (i = 0; i < MAX_SIZE_TBL; i++) {
+        if (quick && size_tbl[i].large) {
+            continue;
+        }
+        pixels = NULL;
+        for (type = 0; type < MAX_CORPUS_TYPE; type++) {
+            sprintf(file_name, "%s/%s_%dx%d.%s",
+                    corpus_dir, CORPUS_TYPE_STR(type), size_tbl[i].w, size_tbl[i].h, CORPUS_TYPE_EXT(type));
+            if (access(file_name, F_OK) == 0) {
+                continue;
+            }
+            if (pixels == NULL) {
+                pixels = synthetic_pixels(size_tbl[i].w, size_tbl[i].h, i);
+            }
+            write_corpus_file(file_name, type, pixels, size_tbl[i].w, size_tbl[i].h);
+        }
+        free(pixels);
+    }
+
+    // generate the e2e input files, these are 320x240 and cycle through the jpeg 
+    // and png rgba types;
+    // the names are kept short so the e2e command line stays small
+    for (i = 0; i < MAX_E2E_INPUTS; i++) {
+        type = i % MAX_E2E_CORPUS_TYPE;
+        sprintf(file_name, "%s/e2e/%4.4d.%s", corpus_dir, i, CORPUS_TYPE_EXT(type));
+        if (access(file_name, F_OK) == 0) {
+            continue;
+        }
+        pixels = synthetic_pixels(320, 240, 1000+i);
+        write_corpus_file(file_name, type, pixels, 320, 240);
+        free(pixels);
+    }
+
+    INFO("generated corpus in %s, %.3f secs\n", corpus_dir, (microsec_timer() - start) / 1000000.);
+}
+
+// -----------------  BENCHMARKS  ---------------------------------------------------------------
+
+static void bench_decode(void)
+{
+    char      file_name[PATH_MAX], name[100];
+    uint64_t  sample_us[MAX_SAMPLE];
+    uint8_t * pixels;
+    int32_t   i, type, r, w, h, ret;
+
+    for (i = 0; i < MAX_SIZE_TBL; i++) {
+        if (quick && size_tbl[i].large) {
+            continue;
+        }
+        for (type = 0; type < MAX_CORPUS_TYPE; type++) {
+            sprintf(file_name, "%s/%s_%dx%d.%s",
+                    corpus_dir, CORPUS_TYPE_STR(type), size_tbl[i].w, size_tbl[i].h, CORPUS_TYPE_EXT(type));
+            for (r = 0; r < reps; r++) {
+                uint64_t start = microsec_timer();
+                if (CORPUS_TYPE_IS_PNG(type)) {
+                    ret = read_png_file(file_name, 0, &pixels, &w, &h, NULL, NULL);
+                } else {
+                    ret = read_jpeg_file(file_name, 0, 1, &pixels, &w, &h, NULL, NULL);
+                }
+                sample_us[r] = microsec_timer() - start;
+                if (ret != 0) {
+                    FATAL("failed to read %s\n", file_name);
+                }
+                free(pixels);
+            }
+            sprintf(name, "decode %s %dx%d", CORPUS_TYPE_STR(type), size_tbl[i].w, size_tbl[i].h);
+            add_result(name, sample_us, reps, size_tbl[i].w * size_tbl[i].h / 1e6, "MP/s");
+        }
+    }
+}
+
+static void bench_encode(void)
+{
+    char      file_name[PATH_MAX], name[100];
+    uint64_t  sample_us[MAX_SAMPLE];
+    uint8_t * pixels;
+    int32_t   i, r, ret;
+    bool      png;
+
+    for (i = 0; i < MAX_SIZE_TBL; i++) {
+        if (quick && size_tbl[i].large) {
+            continue;
+        }
+        pixels = synthetic_pixels(size_tbl[i].w, size_tbl[i].h, 2000+i);
+        for (png = false; ; png = true) {
+            sprintf(file_name, "%s/encode_out.%s", corpus_dir, png ? "png" : "jpg");
+            for (r = 0; r < reps; r++) {
+                uint64_t start = microsec_timer();
+                if (png) {
+                    ret = write_png_file(file_name, pixels, size_tbl[i].w, size_tbl[i].h, NULL, 0);
+                } else {
+                    ret = write_jpeg_file(file_name, pixels, size_tbl[i].w, size_tbl[i].h, NULL, 0);
+                }
+                sample_us[r] = microsec_timer() - start;
+                if (ret != 0) {
+                    FATAL("failed to write %s\n", file_name);
+                }
+            }
+            sprintf(name, "encode %s %dx%d", png ? "png" : "jpeg", size_tbl[i].w, size_tbl[i].h);
+            add_result(name, sample_us, reps, size_tbl[i].w * size_tbl[i].h / 1e6, "MP/s");
+            if (png) {
+                break;
+            }
+        }
+        free(pixels);
+    }
+}
+
+// the same sequence of sdl calls that draw_images uses when a pane's
+// cached texture needs to be created
+static void bench_resample(void)
+{
+    char      name[100];
+    uint64_t  sample_us[MAX_SAMPLE];
+    uint8_t * pixels;
+    rect_t    pane_full, pane;
+    int32_t   i, r;
+
+    sdl_init_pane(&pane_full, &pane, 0, 0, 320, 240);
+
+    for (i = 0; i < MAX_SIZE_TBL; i++) {
+        if (quick && size_tbl[i].large) {
+            continue;
+        }
+        pixels = synthetic_pixels(size_tbl[i].w, size_tbl[i].h, 3000+i);
+        for (r = 0; r < reps; r++) {
+            texture_t texture, cached_texture;
+            uint64_t start = microsec_timer();
+            sdl_display_init();
+            texture = sdl_create_texture(size_tbl[i].w, size_tbl[i].h);
+            sdl_update_texture(texture, pixels, size_tbl[i].w);
+            cached_texture = sdl_create_scaled_texture(texture, NULL, pane.w, pane.h);
+            sdl_destroy_texture(texture);
+            sdl_render_texture(cached_texture, &pane);
+            sdl_display_present();
+            sample_us[r] = microsec_timer() - start;
+            if (cached_texture == NULL) {
+                FATAL("failed to create pane texture\n");
+            }
+            sdl_destroy_texture(cached_texture);
+        }
+        free(pixels);
+        sprintf(name, "resample %dx%d to %dx%d", size_tbl[i].w, size_tbl[i].h, pane.w, pane.h);
+        add_result(name, sample_us, reps, size_tbl[i].w * size_tbl[i].h / 1e6, "MP/s");
+    }
+}
+
+static void bench_composite(void)
+{
+    static const int32_t max_pane_tbl[] = { 10, 100, 1000 };
+
+    char        name[100];
+    uint64_t    sample_us[MAX_SAMPLE];
+    texture_t * texture;
+    atlas_slot_t * slot;
+    rect_t    * pane, * pane_full;
+    uint8_t   * pixels;
+    int32_t     win_width, win_height, cols, rows, pane_w, pane_h;
+    int32_t     i, j, r, max_pane;
+
+    sdl_get_state(&win_width, &win_height, NULL);
+
+    for (i = 0; i < sizeof(max_pane_tbl) / sizeof(max_pane_tbl[0]); i++) {
+        max_pane = max_pane_tbl[i];
+        cols = ceil(sqrt(max_pane));
+        rows = ceil((double)max_pane / cols);
+        pane_w = win_width / cols;
+        pane_h = win_height / rows;
+
+        // create a distinct texture for each pane, as draw_images does
+        texture   = calloc(max_pane, sizeof(texture_t));
+        pane      = calloc(max_pane, sizeof(rect_t));
+        pane_full = calloc(max_pane, sizeof(rect_t));
+        pixels = synthetic_pixels(pane_w, pane_h, 4000+i);
+        for (j = 0; j < max_pane; j++) {
+            sdl_init_pane(&pane_full[j], &pane[j], (j % cols) * pane_w, (j / cols) * pane_h, pane_w, pane_h);
+            texture[j] = sdl_create_texture(pane[j].w, pane[j].h);
+            sdl_update_texture(texture[j], pixels, pane_w);
+        }
+        free(pixels);
+
+        // time rendering all the panes and borders, and presenting the display
+        for (r = 0; r < reps; r++) {
+            uint64_t start = microsec_timer();
+            sdl_display_init();
+            for (j = 0; j < max_pane; j++) {
+                sdl_render_texture(texture[j], &pane[j]);
+                sdl_render_pane_border(&pane_full[j], GREEN);
+            }
+            sdl_display_present();
+            sample_us[r] = microsec_timer() - start;
+        }
+        sprintf(name, "composite %d panes %dx%d", max_pane, win_width, win_height);
+        add_result(name, sample_us, reps, max_pane, "images/s");
+
+        // copy the textures to atlas slots, and time rendering the panes 
+        // using the batched atlas render, as draw_images does
+        slot = calloc(max_pane, sizeof(atlas_slot_t));
+        for (j = 0; j < max_pane; j++) {
+            if (sdl_atlas_alloc(pane[j].w, pane[j].h, &slot[j]) != 0) {
+                FATAL("failed to allocate atlas slot\n");
+            }
+            sdl_atlas_update(&slot[j], texture[j], NULL);
+        }
+        for (r = 0; r < reps; r++) {
+            uint64_t start = microsec_timer();
+            sdl_display_init();
+            for (j = 0; j < max_pane; j++) {
+                sdl_atlas_render(&slot[j], &pane[j]);
+            }
+            sdl_atlas_render_flush();
+            for (j = 0; j < max_pane; j++) {
+                sdl_render_pane_border(&pane_full[j], GREEN);
+            }
+            sdl_display_present();
+            sample_us[r] = microsec_timer() - start;
+        }
+        sprintf(name, "composite %d panes %dx%d atlas", max_pane, win_width, win_height);
+        add_result(name, sample_us, reps, max_pane, "images/s");
+        sdl_atlas_reset();
+
+        for (j = 0; j < max_pane; j++) {
+            sdl_destroy_texture(texture[j]);
+        }
+        free(texture);
+        free(slot);
+        free(pane);
+        free(pane_full);
+    }
+}
+
+static void bench_e2e(void)
+{
+    char      name[100], output_filename[PATH_MAX], image_merge[PATH_MAX];
+    char      size_str[50], cols_str[50], e2e_dir[PATH_MAX];
+    char    * args[MAX_E2E_INPUTS+20];
+    char      input_name[MAX_E2E_INPUTS][20];
+    uint64_t  sample_us[MAX_SAMPLE];
+    int32_t   i, j, r, max_inputs, cols, max_args, status;
+    pid_t     pid;
+
+    // the image_merge program is run in the e2e corpus directory
+    if (realpath(image_merge_path, image_merge) == NULL) {
+        ERROR("image_merge program %s not found, skipping e2e benchmark\n", image_merge_path);
+        return;
+    }
+    sprintf(e2e_dir, "%s/e2e", corpus_dir);
+    sprintf(output_filename, "%s/e2e_out.jpg", corpus_dir);
+    for (j = 0; j < MAX_E2E_INPUTS; j++) {
+        sprintf(input_name[j], "%4.4d.%s", j, CORPUS_TYPE_EXT(j % MAX_E2E_CORPUS_TYPE));
+    }
+
+    for (i = 0; i < MAX_E2E_INPUTS_TBL; i++) {
+        max_inputs = e2e_inputs_tbl[i];
+        if (quick && max_inputs >= 1000) {
+            continue;
+        }
+
+        // construct the image_merge args
+        cols = ceil(sqrt(max_inputs));
+        if (cols > 10) {
+            cols = 10;
+        }
+        sprintf(size_str, "%dx%d", 1280, 960);
+        sprintf(cols_str, "%d", cols);
+        max_args = 0;
+        args[max_args++] = image_merge;
+        args[max_args++] = "-z";
+        args[max_args++] = "-o";
+        args[max_args++] = size_str;
+        args[max_args++] = "-c";
+        args[max_args++] = cols_str;
+        args[max_args++] = "-f";
+        args[max_args++] = output_filename;
+        for (j = 0; j < max_inputs; j++) {
+            args[max_args++] = input_name[j];
+        }
+        args[max_args] = NULL;
+
+        // run image_merge reps times, with its output discarded
+        for (r = 0; r < reps; r++) {
+            uint64_t start = microsec_timer();
+            pid = fork();
+            if (pid == 0) {
+                int32_t fd = open("/dev/null", O_WRONLY);
+                dup2(fd, 1);
+                dup2(fd, 2);
+                if (chdir(e2e_dir) != 0) {
+                    _exit(126);
+                }
+                execv(image_merge, args);
+                _exit(127);
+            }
+            if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+                FATAL("failed to run %s, %s\n", image_merge, strerror(errno));
+            }
+            sample_us[r] = microsec_timer() - start;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ERROR("%s with %d inputs failed, status=0x%x, skipping\n", image_merge, max_inputs, status);
+                break;
+            }
+        }
+        if (r < reps) {
+            continue;
+        }
+
+        sprintf(name, "e2e %d inputs", max_inputs);
+        add_result(name, sample_us, reps, max_inputs, "images/s");
+        if (max_inputs == LATENCY_CHECK_INPUTS && max_result > 0) {
+            latency_ms = result[max_result-1].median_ms;
+        }
+    }
+}
+
+// -----------------  RESULTS  ------------------------------------------------------------------
+
+static int compare_uint64(const void * a, const void * b)
+{
+    uint64_t x = *(uint64_t*)a;
+    uint64_t y = *(uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// work is the number of megapixels or images processed by each sample,
+// the throughput is based on the median time
+static void add_result(char * name, uint64_t * sample_us, int32_t max_sample,
+                       double work, char * throughput_units)
+{
+    result_t * x;
+    int32_t    p99_idx;
+
+    if (max_result == MAX_RESULT) {
+        ERROR("too many results\n");
+        return;
+    }
+    x = &result[max_result++];
+
+    qsort(sample_us, max_sample, sizeof(uint64_t), compare_uint64);
+    p99_idx = ceil(0.99 * max_sample) - 1;
+
+    strcpy(x->name, name);
+    x->reps       = max_sample;
+    x->min_ms     = sample_us[0] / 1000.;
+    x->median_ms  = (max_sample & 1) ? sample_us[max_sample/2] / 1000.
+                                     : (sample_us[max_sample/2-1] + sample_us[max_sample/2]) / 2000.;
+    x->p99_ms     = sample_us[p99_idx] / 1000.;
+    x->throughput = (x->median_ms > 0 ? work / (x->median_ms / 1000.) : 0);
+    x->throughput_units = throughput_units;
+
+    // print the result now, so progress can be seen while the benchmarks run
+    INFO("%s: median %.3f ms\n", x->name, x->median_ms);
+}
+
+static void print_results(void)
+{
+    int32_t i;
+
+    printf("%-44s %5s %12s %12s %12s %14s\n",
+           "BENCHMARK", "REPS", "MIN_MS", "MEDIAN_MS", "P99_MS", "THROUGHPUT");
+    for (i = 0; i < max_result; i++) {
+        result_t * x = &result[i];
+        printf("%-44s %5d %12.3f %12.3f %12.3f %9.2f %s\n",
+               x->name, x->reps, x->min_ms, x->median_ms, x->p99_ms,
+               x->throughput, x->throughput_units);
+    }
+}
+
+static void write_json(void)
+{
+    FILE  * fp;
+    int32_t i;
+
+    fp = fopen(json_filename, "w");
+    if (fp == NULL) {
+        ERROR("fopen %s, %s\n", json_filename, strerror(errno));
+        return;
+    }
+
+    fprintf(fp, "[\n");
+    for (i = 0; i < max_result; i++) {
+        result_t * x = &result[i];
+        fprintf(fp, "  { \"name\": \"%s\", \"reps\": %d, \"min_ms\": %.3f, \"median_ms\": %.3f, "
+                    "\"p99_ms\": %.3f, \"throughput\": %.3f, \"throughput_units\": \"%s\" }%s\n",
+                x->name, x->reps, x->min_ms, x->median_ms, x->p99_ms,
+                x->throughput, x->throughput_units,
+                i < max_result-1 ? "," : "");
+    }
+    fprintf(fp, "]\n");
+
+    fclose(fp);
+    INFO("wrote results to %s\n", json_filename);
+}
@@ -27,6 +27,9 @@ SOFTWARE.
 // DESCRIPTION
 //     This program reads jpeg and png files and combines them into a
 //     single jpeg or png output file. Each of the images can optionally be cropped.
+//     The images are read by background threads; the window is displayed immediately,
+//     with a placeholder for each image that has not yet been read, and a low quality
+//     preview of each jpeg image is displayed until the full quality image is read.
 // 
 // OPTIONS
 //     -i WxH      : initial width/height of each image, default 320x240 
@@ -39,16 +42,53 @@ SOFTWARE.
 //     -c NUM      : initial number of columns, default is
 //                   based on number of images and layout
 //     -f NAME     : output filename, must have .jpg or .png extension,
-//                   default 'out.jpg'
-//     -l LAYOUT   : 1 = equal size; 2 = first image double size, default 1
+//                   default 'out.jpg'; when the output is png and any of the 
+//                   images is a png with 16 bit samples, the output has 16 bit
+//                   samples, and is resampled and composited by the cpu
+//     -l LAYOUT   : 1 = equal size; 2 = first image double size; 3 = justified rows, 
+//                   each image is displayed at its aspect ratio in rows that fill
+//                   the width, and cols is the average number of images per row;
+//                   4 = mosaic, each image is displayed at its aspect ratio and
+//                   all with the same area, packed to fill the window;
+//                   default 1
+//     -t FILE     : layout template file, which overrides -l; the template 
+//                   defines image regions using nested splits, grids with cells
+//                   that span rows and cols, fixed regions, and padding; see 
+//                   util_template.h for the format
 //     -b COLOR    : select border color, default GREEN, choices are 
 //                   NONE, PURPLE, BLUE, LIGHT_BLUE, GREEN, YELLOW, ORANGE, 
 //                   PINK, RED, GRAY, WHITE, BLACK 
 //     -k n,x,y,w,h: crop image n; x,y,w,h are in percent; x,y are the upper left of
 //                   the crop area; w,h are the size of the crop area
+//     -a          : auto crop, each image is cropped to the aspect ratio of its 
+//                   pane, the crop position is where the image has the most detail;
+//                   not for the justified rows and mosaic layouts, and the images 
+//                   cropped by -k, or interactively, are not auto cropped
 //     -z          : enable batch mode, the combined output will be written and
 //                   this program terminates
 //     -h          : help
+//     --stats     : print a table of the time spent in each processing stage
+//                   when the program terminates
+//     --stats-json FILE
+//                 : write the per-image and per-stage timings, and the peak 
+//                   resident memory size, to FILE in json format
+//     --trace FILE: write a timeline of the processing stages to FILE, in 
+//                   chrome trace-event json format; view using ui.perfetto.dev
+//     --mem-budget SIZE
+//                 : limit the memory used for decoded image pixels to SIZE bytes,
+//                   SIZE may have a K, M or G suffix; when over budget the least 
+//                   recently used decoded images are freed, and are decoded again 
+//                   if needed by a crop or layout change
+//     --preview   : in batch mode, display the combined output for 1 second
+//                   before it is written
+//     --icc FILE  : the output color profile; the images are converted from 
+//                   their embedded icc profile, or sRGB if they have none, to 
+//                   this profile, and it is embedded in the output file; without
+//                   this option the images are converted to sRGB, and no profile
+//                   is embedded; just RGB matrix / TRC profiles are supported
+//     --linear    : resample the images in linear light, which preserves the 
+//                   brightness of fine detail when the images are reduced; the 
+//                   images are resampled by the cpu rather than the gpu
 //
 //     -i and -o can not be combined
 // 
@@ -57,6 +97,7 @@ SOFTWARE.
 //         w      write file containing the combined images
 //         q      exit the program
 //         c, C   decrease or increase the number of image columns
+//         d      toggle display of the debug overlay, which shows frame time stats
 //
 //     Window Resize Control
 //         mouse
@@ -70,6 +111,8 @@ SOFTWARE.
 //         Esc               exit crop mode without applying the crop
 //         r                 reset the selected image to it's original size
 //         R                 reset all images to their original size
+//     While cropping, the crop area is displayed zoomed, as it will appear once 
+//     applied, in the corner of the window that is furthest from the image.
 //
 
 #include <stdio.h>
@@ -78,9 +121,13 @@ SOFTWARE.
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <errno.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 #include <math.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -88,17 +135,26 @@ SOFTWARE.
 #include "util_sdl.h"
 #include "util_jpeg.h"
 #include "util_png.h"
+#include "util_stats.h"
+#include "util_layout.h"
+#include "util_probe.h"
+#include "util_template.h"
+#include "util_autocrop.h"
+#include "util_icc.h"
+#include "util_resample.h"
 #include "util_misc.h"
 
 // 
 // defines
 //
 
-#define MAX_IMAGE 1000
 #define MAX_BORDER_COLOR_TBL (sizeof(border_color_tbl) / sizeof(border_color_tbl[0]))
 
 #define LAYOUT_EQUAL_SIZE              1
 #define LAYOUT_FIRST_IMAGE_DOUBLE_SIZE 2
+#define LAYOUT_JUSTIFIED_ROWS          3
+#define LAYOUT_MOSAIC                  4
+#define LAYOUT_TEMPLATE                5
 
 #define DEFAULT_IMAGE_WIDTH  320
 #define DEFAULT_IMAGE_HEIGHT 240
@@ -109,6 +165,35 @@ SOFTWARE.
 
 #define CROP_STEP 0.5
 
+#define MAX_FRAME_TIME 64
+
+#define MAX_MIP_LEVEL  4
+#define MIN_MIP_DIM    8
+#define RESIZE_IDLE_MS 300
+
+#define MAX_SOURCE_TEXTURE 8
+
+#define IMAGE_TYPE_UNKNOWN PROBE_TYPE_UNKNOWN
+#define IMAGE_TYPE_PNG     PROBE_TYPE_PNG
+#define IMAGE_TYPE_JPEG    PROBE_TYPE_JPEG
+
+#define IMAGE_STATE_LOADING  0
+#define IMAGE_STATE_PREVIEW  1
+#define IMAGE_STATE_LOADED   2
+#define IMAGE_STATE_ERROR    3
+
+#define MAX_LOAD_THREAD 16
+
+#define EVENT_IMAGE_LOADED  (SDL_EVENT_USER_START + 0)
+
+#define OPT_STATS       1000
+#define OPT_STATS_JSON  1001
+#define OPT_TRACE       1002
+#define OPT_MEM_BUDGET  1003
+#define OPT_PREVIEW     1004
+#define OPT_ICC         1005
+#define OPT_LINEAR      1006
+
 //
 // typedefs
 //
@@ -118,28 +203,137 @@ typedef struct {
 } crop_t;
 
 typedef struct {
-    char    * filename;
-    uint8_t * pixels;
-    int32_t   width;
-    int32_t   height;
-    crop_t    crop;
-} image_t;
+    int32_t idx;
+    crop_t  crop;
+} crop_arg_t;
 
 typedef struct {
     char * name;
     int32_t color;
 } border_color_t;
 
+typedef struct load_done_s {
+    struct load_done_s * next;
+    int32_t   idx;
+    int32_t   state;
+    uint8_t * pixels;
+    int32_t   width;
+    int32_t   height;
+    autocrop_profile_t * autocrop;
+} load_done_t;
+
 // 
 // variables
 //
 
-static int32_t   max_image;
-static image_t   image[MAX_IMAGE];
-static rect_t    pane[MAX_IMAGE], pane_full[MAX_IMAGE];
-static texture_t cached_texture[MAX_IMAGE];
+// the per-image state is kept in separate arrays, indexed by image, rather 
+// than in an array of structs; so the layout and draw loops, which run over 
+// all images, touch just the arrays they need; these are allocated by 
+// image_alloc once max_image is known
+static int32_t     max_image;
+static char     ** image_filename;
+static uint8_t  ** image_pixels;
+static int32_t   * image_w;
+static int32_t   * image_h;
+static crop_t    * image_crop;
+static int32_t   * image_type;
+static int32_t   * image_probe_w;     // the dimensions from the image file header, after
+                                      // the exif orientation is applied
+static int32_t   * image_probe_h;
+static int32_t   * image_orientation; // the exif orientation, 1 - 8
+static int32_t   * image_bit_depth;   // bits per sample in the image file, 8 or 16
+static int32_t   * image_state;
+static rect_t    * pane;
+static rect_t    * pane_full;
+static rect_t    * pane_full_prior;
+static texture_t * cached_texture;
+static atlas_slot_t * cached_slot;
+static atlas_slot_t * cached_mip;      // MAX_MIP_LEVEL entries per image
+static bool         * cached_stale;
+static bool           cached_stale_any;
+static bool      * pane_dirty;
+
+// when autocrop_enabled, the images that have image_autocrop set are cropped to 
+// the aspect ratio of their pane; the crop is chosen using the energy profile, 
+// which is computed by the load threads from the first pixels loaded, usually the 
+// preview; image_autocrop_aspect is the pane aspect ratio the crop was chosen for;
+// image_autocrop_preview is set by the load threads when the profile has been 
+// computed from the preview, otherwise the profile is computed from the full image
+static bool                  autocrop_enabled;
+static bool                * image_autocrop;
+static autocrop_profile_t ** image_autocrop_profile;
+static double              * image_autocrop_aspect;
+static bool                * image_autocrop_preview;
+
+// when linear_enabled, the cached textures are resampled from the image pixels 
+// by the cpu in linear light, see util_resample.c, rather than from the source 
+// textures by the gpu
+static bool                  linear_enabled;
+
+// when output_16bit, the output png file has 16 bit samples; the images are 
+// decoded again, at 16 bits, resampled and composited by the cpu, see 
+// output_write_16bit; the display is still 8 bit
+static bool                  output_16bit;
+
+// the full resolution source textures of the most recently used images, 
+// most recent first; the cached textures are rendered from these using the 
+// crop area as the source rectangle, so that applying or adjusting a crop 
+// does not upload the image pixels again
+static int32_t     source_texture_idx[MAX_SOURCE_TEXTURE];
+static texture_t   source_texture[MAX_SOURCE_TEXTURE];
+static int32_t     max_source_texture;
 
 static int32_t   max_pane;
+static int32_t   max_texture_dim;
+
+// when mem_budget is non zero the decoded image pixels are kept on a
+// least recently used list; the image_lru_prev/next arrays are indexed by image,
+// and mem_resident is the total size of the image pixels currently allocated
+static uint64_t    mem_budget;
+static uint64_t    mem_resident;
+static int32_t   * image_lru_prev;
+static int32_t   * image_lru_next;
+static int32_t     image_lru_head = -1;
+static int32_t     image_lru_tail = -1;
+
+// the panes are rendered to frame_texture, which is retained between draws;
+// only the panes that are marked in pane_dirty are rendered again, unless 
+// frame_redraw_all is set; for example, moving the crop rectangle does not 
+// require any pane to be rendered again because it is drawn over the frame_texture
+static texture_t   frame_texture;
+static int32_t     frame_width;
+static int32_t     frame_height;
+static bool        frame_redraw_all;
+
+// frame time stats, displayed by the debug overlay
+static bool        debug_overlay;
+static uint64_t    frame_time[MAX_FRAME_TIME];
+static uint64_t    frame_count;
+static int32_t     frame_panes_drawn;
+
+// the images are loaded by the load threads; each image is first loaded as a 
+// preview (if it is a jpeg and not in batch mode), and then at full quality; the 
+// load threads put the loaded images on the load_done list, and notify the main
+// thread with EVENT_IMAGE_LOADED; the main thread takes the loaded images from the
+// load_done list and installs them, see image_load_done_process;
+// when mem_budget is non zero, load_mem_pending is the size of the full images on
+// the load_done list, and load_mem_resident is the value of mem_resident when the
+// main thread last installed images; the load threads wait on load_mem_cond while
+// these are over the mem_budget
+static pthread_t       load_thread[MAX_LOAD_THREAD];
+static int32_t         max_load_thread;
+static int32_t         load_next_work;
+static bool            load_preview;
+static bool            load_stop;
+static pthread_mutex_t load_done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  load_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  load_mem_cond = PTHREAD_COND_INITIALIZER;
+static load_done_t   * load_done_head;
+static load_done_t   * load_done_tail;
+static bool            load_done_event_pending;
+static uint64_t        load_mem_pending;
+static uint64_t        load_mem_resident;
+static int32_t         images_loading;
 
 static bool      crop_enabled;
 static int32_t   crop_idx;
@@ -147,6 +341,8 @@ static crop_t    crop;
 static crop_t    crop_uncropped;
 
 static int32_t   layout = LAYOUT_EQUAL_SIZE;
+static char    * layout_template_filename;
+static template_t layout_template;
 
 static const border_color_t border_color_tbl[] = {
         { "PURPLE",     PURPLE     },
@@ -163,12 +359,56 @@ static const border_color_t border_color_tbl[] = {
 static int32_t  border_color;
 static char   * border_color_str;
 
+static bool      stats_summary;
+static char    * stats_json_filename;
+static char    * trace_filename;
+
+// the output icc profile, NULL when the output is sRGB
+static char    * icc_filename;
+static uint8_t * icc_profile;
+static int32_t   icc_profile_len;
+
 // 
 // prototypes
 //
 
 static void usage(void);
+static void image_alloc(void);
+static void cached_texture_invalidate(int32_t idx);
+static void cached_texture_invalidate_all(void);
+static void cached_texture_mark_stale_all(void);
+static void cached_mip_build(int32_t idx);
+static void cached_texture_create_linear(int32_t idx, frect_t * srcrect, int32_t w, int32_t h);
+static atlas_slot_t * cached_mip_select(int32_t idx, int32_t w, int32_t h);
+static texture_t source_texture_get(int32_t idx);
+static void source_texture_release(int32_t idx);
+static crop_t crop_combine(crop_t * outer, crop_t * inner);
+static void image_crop_rect(int32_t idx, crop_t * crop, frect_t * rect);
+static void image_probe_all(void);
+static void * image_probe_thread(void * cx);
+static int32_t image_thread_count(void);
+static void image_load_start(void);
+static void image_load_wait(void);
+static void image_load_stop(void);
+static void * image_load_thread(void * cx);
+static int32_t image_load_mem_wait(void);
+static void image_load(int32_t idx, bool preview);
+static void image_load_done_process(void);
+static int32_t image_decode_file(int32_t idx, char * filename, int32_t type, 
+                                 uint8_t ** pixels, int32_t * width, int32_t * height);
+static int32_t image_decode(int32_t idx);
+static uint16_t * image_decode_16bit(int32_t idx, int32_t * width, int32_t * height);
+static uint8_t * image_pixels_get(int32_t idx);
+static void image_lru_insert(int32_t idx);
+static void image_lru_remove(int32_t idx);
+static void image_mem_budget_enforce(void);
+static void image_autocrop_apply(void);
+static int32_t parse_size(char * str, uint64_t * size);
+static void stats_report(char ** image_name);
 void draw_images(void);
+static void draw_crop_preview(rect_t * crop_pane);
+static void output_write_16bit(char * file_name, bool flash_display, int32_t width, int32_t height);
+static void draw_debug_overlay(rect_t * frame_rect);
 static void layout_init(
     int32_t max_image, int32_t image_width, int32_t image_height,     // in
     int32_t * win_width, int32_t * win_height, int32_t * cols,        // in out
@@ -177,6 +417,12 @@ static void layout_get_panes(
     int32_t max_image, int32_t win_width, int32_t win_height, int32_t cols,    // in
     rect_t * pane, rect_t * pane_full, int32_t * max_pane,                     // out
     int32_t * win_width_used, int32_t * win_height_used);
+static void layout_get_panes_aspect(
+    int32_t max_image, int32_t win_width, int32_t win_height, int32_t cols,    // in
+    rect_t * pane, rect_t * pane_full, int32_t * max_pane,                     // out
+    int32_t * win_width_used, int32_t * win_height_used);
+static void layout_get_aspect(int32_t max_image, double * aspect);
+static int32_t layout_grid_edge(int32_t size, int32_t n, int32_t i);
 
 // -----------------  MAIN  ---------------------------------------------------------------------
 
@@ -187,10 +433,12 @@ int main(int argc, char **argv)
     static int32_t  cols, min_cols, max_cols;
     static char     output_filename[PATH_MAX];
     static bool     batch_mode;
-    static int32_t  max_texture_dim;
+    static bool     batch_preview;
     static bool     done;
     static bool     print_screen_request;
     static int32_t  i;
+    static crop_arg_t * crop_arg;
+    static int32_t  max_crop_arg;
 
     // 
     // initialization
@@ -201,13 +449,19 @@ int main(int argc, char **argv)
     border_color = GREEN;
     border_color_str = "GREEN";
     crop_uncropped.w = crop_uncropped.h = 100;
-    for (i = 0; i < MAX_IMAGE; i++) {
-        image[i].crop = crop_uncropped;
-    }
 
     // get options
     while (true) {
-        char opt_char = getopt(argc, argv, "i:o:c:f:l:b:k:zh");
+        static struct option long_options[] = {
+            { "stats",      no_argument,       NULL, OPT_STATS      },
+            { "stats-json", required_argument, NULL, OPT_STATS_JSON },
+            { "trace",      required_argument, NULL, OPT_TRACE      },
+            { "mem-budget", required_argument, NULL, OPT_MEM_BUDGET },
+            { "preview",    no_argument,       NULL, OPT_PREVIEW    },
+            { "icc",        required_argument, NULL, OPT_ICC        },
+            { "linear",     no_argument,       NULL, OPT_LINEAR     },
+            { NULL,         0,                 NULL, 0              } };
+        int32_t opt_char = getopt_long(argc, argv, "i:o:c:f:l:t:b:k:azh", long_options, NULL);
         if (opt_char == -1) {
             break;
         }
@@ -257,11 +511,16 @@ int main(int argc, char **argv)
         case 'l':
             if ((sscanf(optarg, "%d", &layout) != 1) ||
                 (layout != LAYOUT_EQUAL_SIZE && 
-                 layout != LAYOUT_FIRST_IMAGE_DOUBLE_SIZE))
+                 layout != LAYOUT_FIRST_IMAGE_DOUBLE_SIZE &&
+                 layout != LAYOUT_JUSTIFIED_ROWS &&
+                 layout != LAYOUT_MOSAIC))
             {
                 FATAL("invalid '-l %s'\n", optarg);
             }
             break;
+        case 't':
+            layout_template_filename = optarg;
+            break;
         case 'b':
             if (strcasecmp(optarg, "NONE") == 0) {
                 border_color = NO_BORDER;
@@ -284,17 +543,53 @@ int main(int argc, char **argv)
             if (sscanf(optarg, "%d,%lf,%lf,%lf,%lf", &image_idx, &crop.x, &crop.y, &crop.w, &crop.h) != 5) {
                 FATAL("invalid '-k %s'\n", optarg);
             }
-            if (image_idx < 0 || image_idx >= MAX_IMAGE ||
+            if (image_idx < 0 ||
                 crop.x < 0 || crop.y < 0 || crop.w < 5 || crop.h < 5 ||
                 crop.x + crop.w > 100 || crop.y + crop.h > 100) 
             {
                 FATAL("invalid '-k %s'\n", optarg);
             }
-            image[image_idx].crop = crop;
+            // the crop is saved, and applied once max_image is known
+            crop_arg = realloc(crop_arg, (max_crop_arg+1) * sizeof(crop_arg_t));
+            if (crop_arg == NULL) {
+                FATAL("allocate crop_arg failed\n");
+            }
+            crop_arg[max_crop_arg].idx = image_idx;
+            crop_arg[max_crop_arg].crop = crop;
+            max_crop_arg++;
             break; }
+        case 'a':
+            autocrop_enabled = true;
+            break;
         case 'z':
             batch_mode = true;
             break;
+        case OPT_STATS:
+            stats_summary = true;
+            stats_enable();
+            break;
+        case OPT_STATS_JSON:
+            stats_json_filename = optarg;
+            stats_enable();
+            break;
+        case OPT_TRACE:
+            trace_filename = optarg;
+            stats_enable();
+            break;
+        case OPT_MEM_BUDGET:
+            if (parse_size(optarg, &mem_budget) != 0 || mem_budget == 0) {
+                FATAL("invalid '--mem-budget %s'\n", optarg);
+            }
+            break;
+        case OPT_PREVIEW:
+            batch_preview = true;
+            break;
+        case OPT_ICC:
+            icc_filename = optarg;
+            break;
+        case OPT_LINEAR:
+            linear_enabled = true;
+            break;
         case 'h':
             usage();
             exit(0);
@@ -304,6 +599,9 @@ int main(int argc, char **argv)
         }
     }
 
+    // label this thread in the trace file
+    stats_set_thread_name("main");
+
     // if both image and window dims supplied then error
     if (win_width != 0 && image_width != 0) {
         FATAL("-o and -i options can not be combined\n");
@@ -317,6 +615,67 @@ int main(int argc, char **argv)
         exit(1);
     }
 
+    // read the layout template; the template must have a region for each image
+    if (layout_template_filename != NULL) {
+        if (template_read(layout_template_filename, &layout_template) != 0) {
+            FATAL("invalid '-t %s'\n", layout_template_filename);
+        }
+        if (layout_template.max_pane < max_image) {
+            FATAL("template %s has %d image regions, there are %d images\n",
+                  layout_template_filename, layout_template.max_pane, max_image);
+        }
+        layout = LAYOUT_TEMPLATE;
+    }
+
+    // read the output icc profile, this must be before the images are loaded
+    if (icc_filename != NULL) {
+        if (icc_read_file(icc_filename, &icc_profile, &icc_profile_len) != 0 ||
+            icc_set_output_profile(icc_profile, icc_profile_len) != 0)
+        {
+            FATAL("invalid '--icc %s', just RGB matrix / TRC profiles are supported\n", icc_filename);
+        }
+    }
+
+    // the auto crop is to the pane aspect ratio, which for the justified rows 
+    // and mosaic layouts is the aspect ratio of the image
+    if (autocrop_enabled && (layout == LAYOUT_JUSTIFIED_ROWS || layout == LAYOUT_MOSAIC)) {
+        FATAL("-a can not be used with '-l %d'\n", layout);
+    }
+
+    // allocate the per-image arrays, and 
+    // apply the crops supplied by the '-k' options, these images are not auto cropped
+    image_alloc();
+    for (i = 0; i < max_image; i++) {
+        image_autocrop[i] = autocrop_enabled;
+    }
+    for (i = 0; i < max_crop_arg; i++) {
+        if (crop_arg[i].idx >= max_image) {
+            FATAL("invalid '-k %d,...', there are %d images\n", crop_arg[i].idx, max_image);
+        }
+        image_crop[crop_arg[i].idx] = crop_arg[i].crop;
+        image_autocrop[crop_arg[i].idx] = false;
+    }
+    free(crop_arg);
+
+    // probe the header of each image file, to get the image dimensions that
+    // are used by the layout before the images are read
+    for (i = 0; i < max_image; i++) {
+        image_filename[i] = argv[optind+i];
+    }
+    image_probe_all();
+
+    // the output has 16 bit samples if it is png and any image has 16 bit samples;
+    // the output_filename has been verified to have a .jpg or .png extension
+    if (strcmp(output_filename+strlen(output_filename)-4, ".png") == 0) {
+        for (i = 0; i < max_image; i++) {
+            if (image_bit_depth[i] == 16) {
+                output_16bit = true;
+                INFO("the output has 16 bit samples, %s has 16 bit samples\n", image_filename[i]);
+                break;
+            }
+        }
+    }
+
     // layout init
     layout_init(max_image, image_width, image_height,  // in
                 &win_width, &win_height, &cols,        // in out
@@ -327,28 +686,13 @@ int main(int argc, char **argv)
         FATAL("sdl_init %dx%d failed\n", win_width, win_height);
     }
 
-    // read all jpeg / png image files
-    for (i = 0; i < max_image; i++) {
-        char * filename = argv[optind+i];
-        struct stat buf;
-
-        image[i].filename = filename;
-
-        if (stat(filename, &buf) != 0) {
-            ERROR("failed stat of %s, %s\n", filename, strerror(errno));
-            continue;
-        }
-
-        if (read_png_file(filename, max_texture_dim, &image[i].pixels, &image[i].width, &image[i].height) == 0) {
-            INFO("read png file %s  %dx%d\n", filename, image[i].width, image[i].height);
-            continue;
-        }
-        if (read_jpeg_file(filename, max_texture_dim, &image[i].pixels, &image[i].width, &image[i].height) == 0) {
-            INFO("read jpeg file %s  %dx%d\n", filename, image[i].width, image[i].height);
-            continue;
-        }
-
-        ERROR("file %s is not in a supported jpeg or png format\n", filename);
+    // start reading all jpeg / png image files, using background threads;
+    // the images that have not yet been loaded are displayed as placeholders;
+    // in batch mode, wait for all images to be loaded
+    load_preview = !batch_mode;
+    image_load_start();
+    if (batch_mode) {
+        image_load_wait();
     }
 
 
@@ -360,6 +704,7 @@ int main(int argc, char **argv)
     while (true) {
         int32_t win_width_used, win_height_used;
         static sdl_event_t * event;
+        static bool redraw;
 
         // get current window size
         sdl_get_state(&win_width, &win_height, NULL);
@@ -383,50 +728,102 @@ int main(int argc, char **argv)
             FATAL("max_pane=%d is less than max_image=%d\n", max_pane, max_image);
         }
 
+        // if the pane of an image has changed, for example the justified rows layout 
+        // changes when an image is loaded, then the frame is redrawn; and if the
+        // pane size has changed then the image's cached texture is marked stale
+        for (i = 0; i < max_image; i++) {
+            if (memcmp(&pane_full[i], &pane_full_prior[i], sizeof(rect_t)) == 0) {
+                continue;
+            }
+            if ((pane_full[i].w != pane_full_prior[i].w || pane_full[i].h != pane_full_prior[i].h) &&
+                (cached_slot[i].atlas != -1 || cached_texture[i] != NULL))
+            {
+                cached_stale[i] = true;
+                cached_stale_any = true;
+            }
+            pane_full_prior[i] = pane_full[i];
+            frame_redraw_all = true;
+        }
+
+        // if creating the output file then the stale cached textures, 
+        // if any, are rebuilt at the exact pane size
+        if ((print_screen_request || batch_mode) && cached_stale_any) {
+            cached_texture_invalidate_all();
+        }
+
+        // auto crop the images to the aspect ratio of their panes
+        if (autocrop_enabled) {
+            image_autocrop_apply();
+        }
+
         // use sdl to draw each of the images to its pane
-        // XXX on some computers the draw_images needs to be done
-        //     twice when creating the output file; I don't know why
         draw_images();
-        if (print_screen_request || batch_mode) {
-            draw_images();
-        }
 
         // if need to create the output_file, because either
         // processing the 'w' event, or in batch mode then ...
         if (print_screen_request || batch_mode) {
-            char cmd_str[10000];
-            char *p = cmd_str;
+            char   * cmd_str = NULL;
+            size_t   cmd_str_len;
+            FILE   * fp;
 
             // debug print the name and size of the combined output file being created
             INFO("writing %s, width=%d height=%d\n", output_filename, win_width_used, win_height_used); 
+            if (images_loading > 0) {
+                WARN("%d images have not finished loading\n", images_loading);
+            }
 
-            // debug print the bach command that can be used to recreate
-            p += sprintf(p, "image_merge -o %dx%d -c %d -f %s -l %d -b %s -z ",
-                    win_width_used, win_height_used, cols, output_filename, layout, border_color_str);
-            for (i = 0; i < max_image; i++) {
-                if (memcmp(&image[i].crop, &crop_uncropped, sizeof(crop_t)) != 0) {
-                    p += sprintf(p, "-k %d,%g,%g,%g,%g ",
-                                i, image[i].crop.x, image[i].crop.y, image[i].crop.w, image[i].crop.h);
+            // debug print the bach command that can be used to recreate;
+            // the length of this command is proportional to the number of images,
+            // so it is constructed in a dynamically sized buffer
+            fp = open_memstream(&cmd_str, &cmd_str_len);
+            if (fp != NULL) {
+                fprintf(fp, "image_merge -o %dx%d -c %d -f %s -b %s -z ",
+                        win_width_used, win_height_used, cols, output_filename, border_color_str);
+                if (layout == LAYOUT_TEMPLATE) {
+                    fprintf(fp, "-t %s ", layout_template_filename);
+                } else {
+                    fprintf(fp, "-l %d ", layout);
                 }
+                if (icc_filename != NULL) {
+                    fprintf(fp, "--icc %s ", icc_filename);
+                }
+                if (linear_enabled) {
+                    fprintf(fp, "--linear ");
+                }
+                for (i = 0; i < max_image; i++) {
+                    if (memcmp(&image_crop[i], &crop_uncropped, sizeof(crop_t)) != 0) {
+                        fprintf(fp, "-k %d,%g,%g,%g,%g ",
+                                i, image_crop[i].x, image_crop[i].y, image_crop[i].w, image_crop[i].h);
+                    }
+                }
+                for (i = 0; i < max_image; i++) {
+                    fprintf(fp, "%s ", image_filename[i]);
+                }
+                fclose(fp);
+                INFO("%s\n", cmd_str);
+                free(cmd_str);
             }
-            for (i = 0; i < max_image; i++) {
-                p += sprintf(p, "%s ", image[i].filename);
-            }
-            INFO("%s\n", cmd_str);
 
-            // if in batch_mode then delay 1 second so user can briefly see 
-            // what the output_filename will look like
-            if (batch_mode) {
+            // if in batch_mode, and the preview option was supplied, then delay 
+            // 1 second so user can briefly see what the output_filename will look like
+            if (batch_mode && batch_preview) {
                 sleep(1);
             }
 
-            // create the output_filename, 
+            // create the output_filename from the frame_texture, which contains
+            // the completed frame without the crop rectangle or debug overlay;
             // when invoked with print_screen_request then flash the screen
-            rect_t rect = {0, 0, win_width_used, win_height_used};
-            sdl_print_screen(output_filename, print_screen_request, &rect);
+            if (output_16bit) {
+                output_write_16bit(output_filename, print_screen_request, win_width_used, win_height_used);
+            } else {
+                rect_t rect = {0, 0, win_width_used, win_height_used};
+                sdl_print_texture(output_filename, print_screen_request, frame_texture, &rect,
+                                  icc_profile, icc_profile_len);
+            }
 
             // if in batch_mode then exit the program, else continue so the screen is redrawn
             if (batch_mode) {
+                stats_report(&argv[optind]);
                 exit(0);
             } else {
                 print_screen_request = false;
@@ -456,13 +853,33 @@ int main(int argc, char **argv)
         sdl_event_register(SDL_EVENT_KEY_ESC,               SDL_EVENT_TYPE_KEY, NULL);
         sdl_event_register('r',                             SDL_EVENT_TYPE_KEY, NULL);
         sdl_event_register('R',                             SDL_EVENT_TYPE_KEY, NULL);
-
-        // process events
+        sdl_event_register('d',                             SDL_EVENT_TYPE_KEY, NULL);  // debug overlay
+
+        // process events;
+        // - sleep until the first event arrives, rather than polling
+        // - then process all other pending events before returning to the top of
+        //   the loop to redraw, so that a burst of events (such as key repeat or
+        //   window resizing) is coalesced into a single redraw
+        redraw = false;
         while (true) {
             bool unsupported_event = false;
 
-            // get and process the event
-            event = sdl_poll_event();
+            // get and process the event; if there are stale cached textures then 
+            // the wait is limited to RESIZE_IDLE_MS, and when that expires without
+            // an event the stale cached textures are rebuilt at the exact pane size
+            event = (redraw           ? sdl_poll_event() : 
+                     cached_stale_any ? sdl_wait_event(RESIZE_IDLE_MS) 
+                                      : sdl_wait_event(-1));
+            if (event->event == SDL_EVENT_NONE) {
+                if (redraw) {
+                    break;
+                }
+                if (cached_stale_any) {
+                    cached_texture_invalidate_all();
+                    break;
+                }
+                continue;
+            }
             switch (event->event) {
 
             // quit program
@@ -487,10 +904,7 @@ int main(int argc, char **argv)
                 }
                 sdl_play_event_sound();
                 cols += (event->event == 'c' ? -1 : 1);
-                for (i = 0; i < MAX_IMAGE; i++) {
-                    sdl_destroy_texture(cached_texture[i]);
-                    cached_texture[i] = NULL;
-                }
+                cached_texture_mark_stale_all();
                 break;
 
             // crop events follow ...
@@ -613,32 +1027,29 @@ int main(int argc, char **argv)
                     break;
                 }
                 sdl_play_event_sound();
-                image[crop_idx].crop.x = image[crop_idx].crop.x + crop.x * image[crop_idx].crop.w / 100;
-                image[crop_idx].crop.w = crop.w * image[crop_idx].crop.w / 100;
-                image[crop_idx].crop.y = image[crop_idx].crop.y + crop.y * image[crop_idx].crop.h / 100;
-                image[crop_idx].crop.h = crop.h * image[crop_idx].crop.h / 100;
-                sdl_destroy_texture(cached_texture[crop_idx]);
-                cached_texture[crop_idx] = NULL;
+                image_crop[crop_idx] = crop_combine(&image_crop[crop_idx], &crop);
+                image_autocrop[crop_idx] = false;
+                cached_texture_invalidate(crop_idx);
                 crop_enabled = false;
                 break;
             case 'r':
                 if (!crop_enabled) {
                     break;
                 }
-                if (memcmp(&image[crop_idx].crop, &crop_uncropped, sizeof(crop_t)) != 0) {
+                image_autocrop[crop_idx] = false;
+                if (memcmp(&image_crop[crop_idx], &crop_uncropped, sizeof(crop_t)) != 0) {
                     sdl_play_event_sound();
-                    image[crop_idx].crop = crop_uncropped;
-                    sdl_destroy_texture(cached_texture[crop_idx]);
-                    cached_texture[crop_idx] = NULL;
+                    image_crop[crop_idx] = crop_uncropped;
+                    cached_texture_invalidate(crop_idx);
                 }
                 break;
             case 'R': {
                 bool did_some_work = false;
                 for (i = 0; i < max_image; i++) {
-                    if (memcmp(&image[i].crop, &crop_uncropped, sizeof(crop_t)) != 0) {
-                        image[i].crop = crop_uncropped;
-                        sdl_destroy_texture(cached_texture[i]);
-                        cached_texture[i] = NULL;
+                    image_autocrop[i] = false;
+                    if (memcmp(&image_crop[i], &crop_uncropped, sizeof(crop_t)) != 0) {
+                        image_crop[i] = crop_uncropped;
+                        cached_texture_invalidate(i);
                         did_some_work = true;
                     }
                 }
@@ -652,13 +1063,32 @@ int main(int argc, char **argv)
                 sdl_play_event_sound();
                 break;
 
+            // the display flash, done when the output file is written, has completed
+            case SDL_EVENT_FLASH_DONE:
+                break;
+
             // window event
             case SDL_EVENT_WIN_SIZE_CHANGE:
+                cached_texture_mark_stale_all();
+                break;
             case SDL_EVENT_WIN_RESTORED:
-                for (i = 0; i < MAX_IMAGE; i++) {
-                    sdl_destroy_texture(cached_texture[i]);
-                    cached_texture[i] = NULL;
-                }
+                frame_redraw_all = true;
+                break;
+
+            // the contents of the frame_texture and the cached textures,
+            // which are all render targets, have been lost
+            case SDL_EVENT_RENDER_TARGETS_RESET:
+                cached_texture_invalidate_all();
+                break;
+
+            // images have been loaded by the load threads
+            case EVENT_IMAGE_LOADED:
+                image_load_done_process();
+                break;
+
+            // toggle debug overlay
+            case 'd':
+                debug_overlay = !debug_overlay;
                 break;
 
             // ignore any other events
@@ -667,13 +1097,15 @@ int main(int argc, char **argv)
                 break;
             }
 
-            // if we've processed an event then break to cause screen redraw
+            // if we've processed an event then a redraw is needed; and if the event
+            // requires immediate action then break to do so without processing other 
+            // pending events
             if (!unsupported_event) {
+                redraw = true;
+            }
+            if (done || print_screen_request) {
                 break;
             }
-
-            // delay 1 ms
-            usleep(1000);
         }
 
         // check if time to exit program
@@ -682,6 +1114,8 @@ int main(int argc, char **argv)
         }
     }
 
+    image_load_stop();
+    stats_report(&argv[optind]);
     return 0;
 }
 
@@ -706,16 +1140,53 @@ OPTIONS\n\
     -c NUM      : initial number of columns, default is\n\
                   based on number of images and layout\n\
     -f NAME     : output filename, must have .jpg or .png extension,\n\
-                  default 'out.jpg'\n\
-    -l LAYOUT   : 1 = equal size; 2 = first image double size, default 1\n\
+                  default 'out.jpg'; when the output is png and any of the \n\
+                  images is a png with 16 bit samples, the output has 16 bit\n\
+                  samples, and is resampled and composited by the cpu\n\
+    -l LAYOUT   : 1 = equal size; 2 = first image double size; 3 = justified rows, \n\
+                  each image is displayed at its aspect ratio in rows that fill\n\
+                  the width, and cols is the average number of images per row;\n\
+                  4 = mosaic, each image is displayed at its aspect ratio and\n\
+                  all with the same area, packed to fill the window;\n\
+                  default 1\n\
+    -t FILE     : layout template file, which overrides -l; the template \n\
+                  defines image regions using nested splits, grids with cells\n\
+                  that span rows and cols, fixed regions, and padding; see \n\
+                  util_template.h for the format\n\
     -b COLOR    : select border color, default GREEN, choices are \n\
                   NONE, PURPLE, BLUE, LIGHT_BLUE, GREEN, YELLOW, ORANGE, \n\
                   PINK, RED, GRAY, WHITE, BLACK \n\
     -k n,x,y,w,h: crop image n; x,y,w,h are in percent; x,y are the upper left of\n\
                   the crop area; w,h are the size of the crop area\n\
+    -a          : auto crop, each image is cropped to the aspect ratio of its \n\
+                  pane, the crop position is where the image has the most detail;\n\
+                  not for the justified rows and mosaic layouts, and the images \n\
+                  cropped by -k, or interactively, are not auto cropped\n\
     -z          : enable batch mode, the combined output will be written and\n\
                   this program terminates\n\
     -h          : help\n\
+    --stats     : print a table of the time spent in each processing stage\n\
+                  when the program terminates\n\
+    --stats-json FILE\n\
+                : write the per-image and per-stage timings, and the peak \n\
+                  resident memory size, to FILE in json format\n\
+    --trace FILE: write a timeline of the processing stages to FILE, in \n\
+                  chrome trace-event json format; view using ui.perfetto.dev\n\
+    --mem-budget SIZE\n\
+                : limit the memory used for decoded image pixels to SIZE bytes,\n\
+                  SIZE may have a K, M or G suffix; when over budget the least \n\
+                  recently used decoded images are freed, and are decoded again \n\
+                  if needed by a crop or layout change\n\
+    --preview   : in batch mode, display the combined output for 1 second\n\
+                  before it is written\n\
+    --icc FILE  : the output color profile; the images are converted from \n\
+                  their embedded icc profile, or sRGB if they have none, to \n\
+                  this profile, and it is embedded in the output file; without\n\
+                  this option the images are converted to sRGB, and no profile\n\
+                  is embedded; just RGB matrix / TRC profiles are supported\n\
+    --linear    : resample the images in linear light, which preserves the \n\
+                  brightness of fine detail when the images are reduced; the \n\
+                  images are resampled by the cpu rather than the gpu\n\
 \n\
     -i and -o can not be combined\n\
 \n\
@@ -724,6 +1195,7 @@ RUN TIME CONTROLS - WHEN NOT IN BATCH MODE\n\
         w      write file containing the combined images\n\
         q      exit the program\n\
         c, C   decrease or increase the number of image columns\n\
+        d      toggle display of the debug overlay, which shows frame time stats\n\
 \n\
     Window Resize Control\n\
         mouse\n\
@@ -737,58 +1209,1157 @@ RUN TIME CONTROLS - WHEN NOT IN BATCH MODE\n\
         Esc               exit crop mode without applying the crop\n\
         r                 reset the selected image to it's original size\n\
         R                 reset all images to their original size\n\
+    While cropping, the crop area is displayed zoomed, as it will appear once \n\
+    applied, in the corner of the window that is furthest from the image.\n\
 ");
 }
 
+// -----------------  PER-IMAGE STATE  ----------------------------------------------------------
+
+static void image_alloc(void)
+{
+    int32_t i;
+
+    image_filename = calloc(max_image, sizeof(char*));
+    image_pixels   = calloc(max_image, sizeof(uint8_t*));
+    image_w        = calloc(max_image, sizeof(int32_t));
+    image_h        = calloc(max_image, sizeof(int32_t));
+    image_crop     = calloc(max_image, sizeof(crop_t));
+    image_type     = calloc(max_image, sizeof(int32_t));
+    image_probe_w  = calloc(max_image, sizeof(int32_t));
+    image_probe_h  = calloc(max_image, sizeof(int32_t));
+    image_orientation = calloc(max_image, sizeof(int32_t));
+    image_bit_depth = calloc(max_image, sizeof(int32_t));
+    image_state    = calloc(max_image, sizeof(int32_t));
+    image_lru_prev = calloc(max_image, sizeof(int32_t));
+    image_lru_next = calloc(max_image, sizeof(int32_t));
+    pane           = calloc(max_image, sizeof(rect_t));
+    pane_full      = calloc(max_image, sizeof(rect_t));
+    pane_full_prior = calloc(max_image, sizeof(rect_t));
+    cached_texture = calloc(max_image, sizeof(texture_t));
+    cached_slot    = calloc(max_image, sizeof(atlas_slot_t));
+    cached_mip     = calloc(max_image * MAX_MIP_LEVEL, sizeof(atlas_slot_t));
+    cached_stale   = calloc(max_image, sizeof(bool));
+    pane_dirty     = calloc(max_image, sizeof(bool));
+    image_autocrop = calloc(max_image, sizeof(bool));
+    image_autocrop_profile = calloc(max_image, sizeof(autocrop_profile_t*));
+    image_autocrop_aspect = calloc(max_image, sizeof(double));
+    image_autocrop_preview = calloc(max_image, sizeof(bool));
+    if (!image_filename || !image_pixels || !image_w || !image_h ||
+        !image_crop || !image_type || !image_probe_w || !image_probe_h || !image_orientation ||
+        !image_bit_depth || !image_state || !image_lru_prev || !image_lru_next ||
+        !pane || !pane_full || !pane_full_prior || !cached_texture || !cached_slot || !cached_mip || 
+        !cached_stale || !pane_dirty || 
+        !image_autocrop || !image_autocrop_profile || !image_autocrop_aspect || !image_autocrop_preview) 
+    {
+        FATAL("allocate per-image arrays failed, max_image=%d\n", max_image);
+    }
+
+    for (i = 0; i < max_image; i++) {
+        image_crop[i] = crop_uncropped;
+        image_lru_prev[i] = image_lru_next[i] = -1;
+        cached_slot[i].atlas = -1;
+    }
+    for (i = 0; i < max_image * MAX_MIP_LEVEL; i++) {
+        cached_mip[i].atlas = -1;
+    }
+}
+
+// the cached pane textures are normally held in an atlas slot, cached_slot; 
+// cached_texture is used when an atlas slot could not be allocated;
+//
+// each cached_slot also has a chain of mip levels, cached_mip, each half the 
+// size of the prior; when the pane size changes, such as while the window is
+// being resized, the cached textures are not rebuilt, instead they are marked 
+// stale and the nearest mip level is scaled to the new pane size by the gpu;
+// the stale cached textures are rebuilt at the exact pane size once there 
+// have been no events for RESIZE_IDLE_MS
+
+// invalidate the cached texture of image idx, and
+// mark its pane to be rendered again
+static void cached_texture_invalidate(int32_t idx)
+{
+    int32_t level;
+
+    sdl_atlas_free(&cached_slot[idx]);
+    for (level = 0; level < MAX_MIP_LEVEL; level++) {
+        sdl_atlas_free(&cached_mip[idx*MAX_MIP_LEVEL+level]);
+    }
+    sdl_destroy_texture(cached_texture[idx]);
+    cached_texture[idx] = NULL;
+    cached_stale[idx] = false;
+    pane_dirty[idx] = true;
+}
+
+// invalidate all cached textures, so the entire frame is rendered again
+static void cached_texture_invalidate_all(void)
+{
+    int32_t i;
+
+    for (i = 0; i < max_image; i++) {
+        cached_slot[i].atlas = -1;
+        sdl_destroy_texture(cached_texture[i]);
+        cached_texture[i] = NULL;
+        cached_stale[i] = false;
+    }
+    for (i = 0; i < max_image * MAX_MIP_LEVEL; i++) {
+        cached_mip[i].atlas = -1;
+    }
+    sdl_atlas_reset();
+    cached_stale_any = false;
+    frame_redraw_all = true;
+}
+
+// mark all cached textures stale; this is used when the pane sizes change
+static void cached_texture_mark_stale_all(void)
+{
+    int32_t i;
+
+    for (i = 0; i < max_image; i++) {
+        if (cached_slot[i].atlas != -1 || cached_texture[i] != NULL) {
+            cached_stale[i] = true;
+            cached_stale_any = true;
+        }
+    }
+    frame_redraw_all = true;
+}
+
+// build the mip levels of image idx from its cached_slot
+static void cached_mip_build(int32_t idx)
+{
+    atlas_slot_t * prev = &cached_slot[idx];
+    atlas_slot_t * mip;
+    int32_t        level, w, h;
+
+    for (level = 0; level < MAX_MIP_LEVEL; level++) {
+        w = prev->rect.w / 2;
+        h = prev->rect.h / 2;
+        if (w < MIN_MIP_DIM || h < MIN_MIP_DIM) {
+            break;
+        }
+        mip = &cached_mip[idx*MAX_MIP_LEVEL+level];
+        if (sdl_atlas_alloc(w, h, mip) != 0) {
+            break;
+        }
+        sdl_atlas_update_from_slot(mip, prev);
+        prev = mip;
+    }
+}
+
+// create the cached texture of image idx, w by h, by resampling the srcrect 
+// region of the image pixels in linear light
+static void cached_texture_create_linear(int32_t idx, frect_t * srcrect, int32_t w, int32_t h)
+{
+    uint8_t * pixels, * scaled;
+
+    if ((pixels = image_pixels_get(idx)) == NULL) {
+        return;
+    }
+    scaled = malloc((size_t)w * h * BYTES_PER_PIXEL);
+    if (scaled == NULL) {
+        ERROR("allocate resample pixels failed, %dx%d\n", w, h);
+        return;
+    }
+
+    if (resample_linear(pixels, image_w[idx], image_h[idx], 
+                        srcrect->x, srcrect->y, srcrect->w, srcrect->h,
+                        scaled, w, h) == 0) 
+    {
+        if (sdl_atlas_alloc(w, h, &cached_slot[idx]) == 0) {
+            sdl_atlas_update_pixels(&cached_slot[idx], scaled, w);
+            cached_mip_build(idx);
+        } else if ((cached_texture[idx] = sdl_create_texture(w, h)) != NULL) {
+            sdl_update_texture(cached_texture[idx], scaled, w);
+        }
+    }
+    free(scaled);
+}
+
+// select the smallest mip level of image idx that is at least w by h;
+// if there is none then the cached_slot is returned
+static atlas_slot_t * cached_mip_select(int32_t idx, int32_t w, int32_t h)
+{
+    atlas_slot_t * slot = &cached_slot[idx];
+    atlas_slot_t * mip;
+    int32_t        level;
+
+    for (level = 0; level < MAX_MIP_LEVEL; level++) {
+        mip = &cached_mip[idx*MAX_MIP_LEVEL+level];
+        if (mip->atlas == -1 || mip->rect.w < w || mip->rect.h < h) {
+            break;
+        }
+        slot = mip;
+    }
+    return slot;
+}
+
+// return the source texture of image idx, creating it from the image pixels if 
+// needed; the least recently used source texture is destroyed when there are 
+// MAX_SOURCE_TEXTURE; NULL is returned if the image pixels are not available
+static texture_t source_texture_get(int32_t idx)
+{
+    texture_t texture;
+    uint8_t * pixels;
+    int32_t   i;
+
+    // if image idx has a source texture then move it to the front, and return it
+    for (i = 0; i < max_source_texture; i++) {
+        if (source_texture_idx[i] == idx) {
+            break;
+        }
+    }
+    if (i < max_source_texture) {
+        texture = source_texture[i];
+    } else {
+        // create the source texture from the image pixels
+        if ((pixels = image_pixels_get(idx)) == NULL) {
+            return NULL;
+        }
+        texture = sdl_create_texture(image_w[idx], image_h[idx]);
+        if (texture == NULL) {
+            return NULL;
+        }
+        sdl_update_texture(texture, pixels, image_w[idx]);
+
+        // if there are MAX_SOURCE_TEXTURE then destroy the least recently used
+        if (max_source_texture == MAX_SOURCE_TEXTURE) {
+            sdl_destroy_texture(source_texture[MAX_SOURCE_TEXTURE-1]);
+            max_source_texture--;
+        }
+        i = max_source_texture++;
+    }
+
+    memmove(&source_texture_idx[1], &source_texture_idx[0], i * sizeof(int32_t));
+    memmove(&source_texture[1], &source_texture[0], i * sizeof(texture_t));
+    source_texture_idx[0] = idx;
+    source_texture[0] = texture;
+    return texture;
+}
+
+// destroy the source texture of image idx, if any; this is used when the image pixels change
+static void source_texture_release(int32_t idx)
+{
+    int32_t i;
+
+    for (i = 0; i < max_source_texture; i++) {
+        if (source_texture_idx[i] == idx) {
+            sdl_destroy_texture(source_texture[i]);
+            memmove(&source_texture_idx[i], &source_texture_idx[i+1], (max_source_texture-i-1) * sizeof(int32_t));
+            memmove(&source_texture[i], &source_texture[i+1], (max_source_texture-i-1) * sizeof(texture_t));
+            max_source_texture--;
+            return;
+        }
+    }
+}
+
+// return the crop that results from applying the inner crop, which is in percent 
+// of the outer crop area, to an image that already has the outer crop
+static crop_t crop_combine(crop_t * outer, crop_t * inner)
+{
+    crop_t c;
+
+    c.x = outer->x + inner->x * outer->w / 100;
+    c.y = outer->y + inner->y * outer->h / 100;
+    c.w = inner->w * outer->w / 100;
+    c.h = inner->h * outer->h / 100;
+    return c;
+}
+
+// convert the crop, which is in percent, to a rectangle in the pixels of image idx;
+// the rectangle is not rounded to whole pixels, the resampler honors the fraction
+static void image_crop_rect(int32_t idx, crop_t * crop, frect_t * rect)
+{
+    rect->x = image_w[idx] * crop->x / 100;
+    rect->y = image_h[idx] * crop->y / 100;
+    rect->w = image_w[idx] * crop->w / 100;
+    rect->h = image_h[idx] * crop->h / 100;
+}
+
+// -----------------  BACKGROUND IMAGE LOADING  ------------------------------------------------
+
+// probe the header of all image files, using multiple threads; this reads just
+// the start of each file, to get the file type, the image dimensions and the exif
+// orientation, so that the layout can use the image dimensions before any image
+// is decoded
+static void image_probe_all(void)
+{
+    pthread_t thread[MAX_LOAD_THREAD];
+    int32_t   i, max_thread;
+    uint64_t  start_us = microsec_timer();
+
+    max_thread = image_thread_count();
+    for (i = 0; i < max_thread; i++) {
+        if (pthread_create(&thread[i], NULL, image_probe_thread, (void*)(intptr_t)i) != 0) {
+            FATAL("pthread_create probe thread %d failed\n", i);
+        }
+    }
+    for (i = 0; i < max_thread; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    INFO("probed %d images using %d threads in %.3f ms\n", 
+         max_image, max_thread, (microsec_timer() - start_us) / 1000.);
+}
+
+static void * image_probe_thread(void * cx)
+{
+    static int32_t probe_next_work;
+    int32_t        id = (intptr_t)cx;
+    int32_t        idx;
+    probe_info_t   info;
+    uint64_t       start;
+    char           name[32];
+
+    sprintf(name, "probe %d", id);
+    stats_set_thread_name(name);
+
+    while ((idx = __atomic_fetch_add(&probe_next_work, 1, __ATOMIC_RELAXED)) < max_image) {
+        start = STATS_SPAN_BEGIN();
+        probe_image_file(image_filename[idx], &info);
+        STATS_SPAN_END(STATS_STAGE_PROBE, idx, start);
+
+        // the exif orientations 5 - 8 rotate the image by 90 degrees, so the 
+        // displayed width and height are swapped
+        image_type[idx]        = info.type;
+        image_probe_w[idx]     = (info.orientation >= 5 ? info.height : info.width);
+        image_probe_h[idx]     = (info.orientation >= 5 ? info.width : info.height);
+        image_orientation[idx] = info.orientation;
+        image_bit_depth[idx]   = info.bit_depth;
+    }
+
+    return NULL;
+}
+
+// return the number of threads to use for probing and loading the images
+static int32_t image_thread_count(void)
+{
+    int32_t n;
+
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) {
+        n = 1;
+    }
+    if (n > MAX_LOAD_THREAD) {
+        n = MAX_LOAD_THREAD;
+    }
+    if (n > max_image) {
+        n = max_image;
+    }
+    return n;
+}
+
+static void image_load_start(void)
+{
+    int32_t i;
+
+    max_load_thread = image_thread_count();
+
+    images_loading = max_image;
+    for (i = 0; i < max_load_thread; i++) {
+        if (pthread_create(&load_thread[i], NULL, image_load_thread, (void*)(intptr_t)i) != 0) {
+            FATAL("pthread_create load thread %d failed\n", i);
+        }
+    }
+    INFO("loading %d images using %d threads\n", max_image, max_load_thread);
+}
+
+// wait for all of the images to be loaded, and install them; the images are 
+// installed as they are loaded, so that the mem_budget is enforced while loading
+static void image_load_wait(void)
+{
+    while (images_loading > 0) {
+        pthread_mutex_lock(&load_done_mutex);
+        while (load_done_head == NULL) {
+            pthread_cond_wait(&load_done_cond, &load_done_mutex);
+        }
+        pthread_mutex_unlock(&load_done_mutex);
+        image_load_done_process();
+    }
+
+    image_load_stop();
+}
+
+// stop the load threads, and wait for them to exit; the load threads finish 
+// the image they are loading, which is not installed; this must be called
+// before the program exits, because the load threads use sdl
+static void image_load_stop(void)
+{
+    int32_t i;
+
+    pthread_mutex_lock(&load_done_mutex);
+    __atomic_store_n(&load_stop, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&load_mem_cond);
+    pthread_mutex_unlock(&load_done_mutex);
+
+    for (i = 0; i < max_load_thread; i++) {
+        pthread_join(load_thread[i], NULL);
+    }
+    max_load_thread = 0;
+}
+
+// the load threads share the work, which is: first the preview of each image,
+// and then the full quality version of each image; so that all of the previews
+// are displayed quickly
+static void * image_load_thread(void * cx)
+{
+    int32_t id = (intptr_t)cx;
+    int32_t work;
+    char    name[32];
+
+    sprintf(name, "load %d", id);
+    stats_set_thread_name(name);
+
+    while (!__atomic_load_n(&load_stop, __ATOMIC_RELAXED) &&
+           (work = __atomic_fetch_add(&load_next_work, 1, __ATOMIC_RELAXED)) < 2 * max_image) 
+    {
+        if (work < max_image) {
+            if (load_preview) {
+                image_load(work, true);
+            }
+        } else if (image_load_mem_wait() == 0) {
+            image_load(work - max_image, false);
+        }
+    }
+
+    return NULL;
+}
+
+// when mem_budget is non zero, wait until the main thread has installed the 
+// full images that are on the load_done list and freed the least recently used 
+// images, so that the decoded images are within the mem_budget; 
+// -1 is returned if the load threads are being stopped
+static int32_t image_load_mem_wait(void)
+{
+    bool stop;
+
+    if (mem_budget == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&load_done_mutex);
+    while (!load_stop && load_mem_pending != 0 && load_mem_resident + load_mem_pending > mem_budget) {
+        pthread_cond_wait(&load_mem_cond, &load_done_mutex);
+    }
+    stop = load_stop;
+    pthread_mutex_unlock(&load_done_mutex);
+
+    return stop ? -1 : 0;
+}
+
+// load the image, and put the result on the load_done list;
+// this is called by the load threads, so it must not access the per-image state;
+// except for the filename, type and orientation, which are not changed once the 
+// images are probed, and image_autocrop_preview which is accessed atomically
+static void image_load(int32_t idx, bool preview)
+{
+    char        * filename = image_filename[idx];
+    load_done_t * done;
+    bool          push_event;
+    struct stat   buf;
+    uint64_t      start;
+    int32_t       ret;
+    uint8_t     * icc;
+    int32_t       icc_len;
+
+    done = calloc(1, sizeof(load_done_t));
+    if (done == NULL) {
+        FATAL("allocate load_done failed\n");
+    }
+    done->idx = idx;
+
+    if (preview) {
+        // a preview is only available for jpeg files; 
+        // if the preview can not be read then just return
+        if (image_type[idx] != IMAGE_TYPE_JPEG ||
+            read_jpeg_file_preview(filename, image_orientation[idx], 
+                                   &done->pixels, &done->width, &done->height,
+                                   &icc, &icc_len) != 0)
+        {
+            free(done);
+            return;
+        }
+        icc_convert(icc, icc_len, done->pixels, (int64_t)done->width * done->height);
+        free(icc);
+        done->state = IMAGE_STATE_PREVIEW;
+        if (autocrop_enabled) {
+            done->autocrop = autocrop_profile_create(done->pixels, done->width, done->height);
+            if (done->autocrop != NULL) {
+                __atomic_store_n(&image_autocrop_preview[idx], true, __ATOMIC_RELEASE);
+            }
+        }
+    } else {
+        start = STATS_SPAN_BEGIN();
+        ret = stat(filename, &buf);
+        STATS_SPAN_END(STATS_STAGE_STAT, idx, start);
+
+        if (ret != 0) {
+            ERROR("failed stat of %s, %s\n", filename, strerror(errno));
+            done->state = IMAGE_STATE_ERROR;
+        } else {
+            if (image_decode_file(idx, filename, image_type[idx], 
+                                  &done->pixels, &done->width, &done->height) == 0) 
+            {
+                INFO("read %s file %s  %dx%d\n", 
+                     image_type[idx] == IMAGE_TYPE_PNG ? "png" : "jpeg",
+                     filename, done->width, done->height);
+                done->state = IMAGE_STATE_LOADED;
+                // the auto crop profile is computed from the full image 
+                // only when there is no preview, or the preview could not be read
+                if (autocrop_enabled && !__atomic_load_n(&image_autocrop_preview[idx], __ATOMIC_ACQUIRE)) {
+                    done->autocrop = autocrop_profile_create(done->pixels, done->width, done->height);
+                }
+            } else {
+                ERROR("file %s is not in a supported jpeg or png format\n", filename);
+                done->state = IMAGE_STATE_ERROR;
+            }
+        }
+    }
+
+    // add to the load_done list; and if the main thread has not 
+    // already been notified then notify it
+    pthread_mutex_lock(&load_done_mutex);
+    if (load_done_tail) {
+        load_done_tail->next = done;
+    } else {
+        load_done_head = done;
+    }
+    load_done_tail = done;
+    if (done->state == IMAGE_STATE_LOADED && mem_budget != 0) {
+        load_mem_pending += (uint64_t)done->width * done->height * BYTES_PER_PIXEL;
+    }
+    push_event = !load_done_event_pending;
+    load_done_event_pending = true;
+    pthread_cond_signal(&load_done_cond);
+    pthread_mutex_unlock(&load_done_mutex);
+
+    if (push_event) {
+        sdl_push_user_event(EVENT_IMAGE_LOADED);
+    }
+}
+
+// install the images that have been loaded by the load threads; 
+// the panes of these images are marked to be rendered again
+static void image_load_done_process(void)
+{
+    load_done_t * done, * next;
+    int32_t       idx;
+    uint64_t      installed = 0;
+
+    pthread_mutex_lock(&load_done_mutex);
+    done = load_done_head;
+    load_done_head = load_done_tail = NULL;
+    load_done_event_pending = false;
+    pthread_mutex_unlock(&load_done_mutex);
+
+    for (; done != NULL; done = next) {
+        next = done->next;
+        idx = done->idx;
+
+        // install the auto crop profile, if this is the first for the image
+        if (done->autocrop != NULL && image_autocrop_profile[idx] == NULL) {
+            image_autocrop_profile[idx] = done->autocrop;
+            image_autocrop_aspect[idx] = 0;
+        } else {
+            free(done->autocrop);
+        }
+
+        if (done->state == IMAGE_STATE_PREVIEW) {
+            // install the preview, unless the full image is already installed
+            if (image_state[idx] == IMAGE_STATE_LOADING) {
+                image_pixels[idx] = done->pixels;
+                image_w[idx] = done->width;
+                image_h[idx] = done->height;
+                image_state[idx] = IMAGE_STATE_PREVIEW;
+                source_texture_release(idx);
+                cached_texture_invalidate(idx);
+            } else {
+                free(done->pixels);
+            }
+        } else {
+            // replace the preview, if any, with the full image
+            free(image_pixels[idx]);
+            image_pixels[idx] = done->pixels;
+            image_w[idx] = done->width;
+            image_h[idx] = done->height;
+            image_state[idx] = done->state;
+            if (done->state == IMAGE_STATE_LOADED && mem_budget != 0) {
+                mem_resident += (uint64_t)image_w[idx] * image_h[idx] * BYTES_PER_PIXEL;
+                installed += (uint64_t)image_w[idx] * image_h[idx] * BYTES_PER_PIXEL;
+                image_lru_insert(idx);
+            }
+            source_texture_release(idx);
+            cached_texture_invalidate(idx);
+            images_loading--;
+        }
+
+        free(done);
+    }
+
+    // if over the memory budget then free the least recently used images, 
+    // and let the load threads that are waiting for memory continue
+    if (mem_budget != 0) {
+        image_mem_budget_enforce();
+        pthread_mutex_lock(&load_done_mutex);
+        load_mem_pending -= installed;
+        load_mem_resident = mem_resident;
+        pthread_cond_broadcast(&load_mem_cond);
+        pthread_mutex_unlock(&load_done_mutex);
+    }
+}
+
+// -----------------  IMAGE DECODE AND MEMORY BUDGET  -------------------------------------------
+
+// decode the image file, and convert it to the output color profile; 
+// this is called by both the load threads and the main thread
+static int32_t image_decode_file(int32_t idx, char * filename, int32_t type, 
+                                 uint8_t ** pixels, int32_t * width, int32_t * height)
+{
+    uint64_t  start;
+    int32_t   ret, icc_len;
+    uint8_t * icc;
+
+    start = STATS_SPAN_BEGIN();
+    if (type == IMAGE_TYPE_PNG) {
+        ret = read_png_file(filename, max_texture_dim, pixels, width, height, &icc, &icc_len);
+    } else if (type == IMAGE_TYPE_JPEG) {
+        ret = read_jpeg_file(filename, max_texture_dim, image_orientation[idx], pixels, width, height,
+                             &icc, &icc_len);
+    } else {
+        ret = -1;
+    }
+    if (ret == 0) {
+        icc_convert(icc, icc_len, *pixels, (int64_t)*width * *height);
+        free(icc);
+    }
+    STATS_SPAN_END(STATS_STAGE_DECODE, idx, start);
+
+    return ret;
+}
+
+// decode image idx at 16 bits per sample, and convert it to the output color 
+// profile; the 8 bit images are widened; the caller should free the pixels
+static uint16_t * image_decode_16bit(int32_t idx, int32_t * width, int32_t * height)
+{
+    uint16_t * pixels16;
+    uint8_t  * pixels, * icc;
+    int32_t    icc_len;
+    int64_t    i, n;
+    uint64_t   start;
+
+    // decode the 16 bit png images
+    if (image_type[idx] == IMAGE_TYPE_PNG && image_bit_depth[idx] == 16) {
+        start = STATS_SPAN_BEGIN();
+        if (read_png_file16(image_filename[idx], &pixels16, width, height, &icc, &icc_len) != 0) {
+            return NULL;
+        }
+        icc_convert16(icc, icc_len, pixels16, (int64_t)*width * *height);
+        free(icc);
+        STATS_SPAN_END(STATS_STAGE_DECODE, idx, start);
+        return pixels16;
+    }
+
+    // widen the 8 bit pixels, which may be a preview; these are already in the
+    // output color profile
+    if ((pixels = image_pixels_get(idx)) == NULL) {
+        return NULL;
+    }
+    n = (int64_t)image_w[idx] * image_h[idx] * BYTES_PER_PIXEL;
+    pixels16 = malloc(n * sizeof(uint16_t));
+    if (pixels16 == NULL) {
+        ERROR("allocate 16 bit pixels failed, %dx%d\n", image_w[idx], image_h[idx]);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        pixels16[i] = pixels[i] * 257;
+    }
+    *width = image_w[idx];
+    *height = image_h[idx];
+    return pixels16;
+}
+
+// decode image idx again, after its pixels were freed by image_mem_budget_enforce
+static int32_t image_decode(int32_t idx)
+{
+    if (image_decode_file(idx, image_filename[idx], image_type[idx], 
+                          &image_pixels[idx], &image_w[idx], &image_h[idx]) != 0) 
+    {
+        return -1;
+    }
+
+    if (mem_budget != 0) {
+        mem_resident += (uint64_t)image_w[idx] * image_h[idx] * BYTES_PER_PIXEL;
+        image_lru_insert(idx);
+    }
+    return 0;
+}
+
+// return the pixels of image idx, decoding the image again if its pixels 
+// had been freed; NULL is returned if the decode fails, or if the image
+// has not been loaded
+static uint8_t * image_pixels_get(int32_t idx)
+{
+    if (image_state[idx] != IMAGE_STATE_LOADED) {
+        return image_pixels[idx];
+    }
+
+    if (image_pixels[idx] == NULL) {
+        if (image_decode(idx) != 0) {
+            ERROR("failed to decode %s again\n", image_filename[idx]);
+            return NULL;
+        }
+        DEBUG("decoded %s again, mem_resident=%" PRIu64 "\n", image_filename[idx], mem_resident);
+    } else if (mem_budget != 0 && image_lru_head != idx) {
+        image_lru_remove(idx);
+        image_lru_insert(idx);
+    }
+    return image_pixels[idx];
+}
+
+// insert image idx at the head (most recently used end) of the lru list
+static void image_lru_insert(int32_t idx)
+{
+    image_lru_prev[idx] = -1;
+    image_lru_next[idx] = image_lru_head;
+    if (image_lru_head != -1) {
+        image_lru_prev[image_lru_head] = idx;
+    } else {
+        image_lru_tail = idx;
+    }
+    image_lru_head = idx;
+}
+
+static void image_lru_remove(int32_t idx)
+{
+    if (image_lru_prev[idx] != -1) {
+        image_lru_next[image_lru_prev[idx]] = image_lru_next[idx];
+    } else {
+        image_lru_head = image_lru_next[idx];
+    }
+    if (image_lru_next[idx] != -1) {
+        image_lru_prev[image_lru_next[idx]] = image_lru_prev[idx];
+    } else {
+        image_lru_tail = image_lru_prev[idx];
+    }
+    image_lru_prev[idx] = image_lru_next[idx] = -1;
+}
+
+// free the pixels of the least recently used images until the memory used is 
+// within mem_budget; the image width and height are retained, so the layout is not affected;
+// just the fully loaded images are on the lru list
+static void image_mem_budget_enforce(void)
+{
+    int32_t idx;
+
+    if (mem_budget == 0) {
+        return;
+    }
+
+    while (mem_resident > mem_budget && (idx = image_lru_tail) != -1) {
+        image_lru_remove(idx);
+        free(image_pixels[idx]);
+        image_pixels[idx] = NULL;
+        mem_resident -= (uint64_t)image_w[idx] * image_h[idx] * BYTES_PER_PIXEL;
+        DEBUG("freed %s, mem_resident=%" PRIu64 "\n", image_filename[idx], mem_resident);
+    }
+}
+
+// parse a size, such as '500M'; the optional suffix is K, M or G, and
+// must be the last character
+static int32_t parse_size(char * str, uint64_t * size)
+{
+    double val;
+    char * end;
+
+    errno = 0;
+    val = strtod(str, &end);
+    if (end == str || errno != 0 || !isfinite(val) || val < 0) {
+        return -1;
+    }
+
+    switch (toupper(*end)) {
+    case '\0':                               break;
+    case 'K': val *= 1024;           end++; break;
+    case 'M': val *= 1024*1024;      end++; break;
+    case 'G': val *= 1024*1024*1024; end++; break;
+    default:  return -1;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+
+    // UINT64_MAX converted to double is 2^64, which is out of range
+    if (val >= (double)UINT64_MAX) {
+        return -1;
+    }
+
+    *size = val;
+    return 0;
+}
+
+// -----------------  16 BIT OUTPUT  ----------------------------------------------------------
+
+// write the output file with 16 bit samples; this does what the gpu does for 
+// the 8 bit output: each image is resampled to its pane, and the pane borders 
+// are drawn, in a 16 bit frame that is width by height; when flash_display
+// the display is flashed after the file is written, as sdl_print_texture does
+static void output_write_16bit(char * file_name, bool flash_display, int32_t width, int32_t height)
+{
+    uint16_t * frame, * pixels16, * p;
+    rect_t   * dest, * r;
+    uint32_t   rgba;
+    uint16_t   color[4];
+    int32_t    x, y, c, w, h;
+    int64_t    i, n;
+    uint64_t   start;
+
+    start = STATS_SPAN_BEGIN();
+
+    // allocate the frame, and fill it with opaque black
+    n = (int64_t)width * height * BYTES_PER_PIXEL;
+    frame = malloc(n * sizeof(uint16_t));
+    if (frame == NULL) {
+        ERROR("allocate 16 bit frame failed, %dx%d\n", width, height);
+        return;
+    }
+    for (i = 0; i < n; i += BYTES_PER_PIXEL) {
+        frame[i+0] = frame[i+1] = frame[i+2] = 0;
+        frame[i+3] = 65535;
+    }
+
+    for (i = 0; i < max_image; i++) {
+        dest = (border_color == NO_BORDER ? &pane_full[i] : &pane[i]);
+        r = &pane_full[i];
+        if (r->x < 0 || r->y < 0 || r->x + r->w > width || r->y + r->h > height || 
+            dest->w <= 0 || dest->h <= 0) 
+        {
+            continue;
+        }
+
+        // resample the crop area of the image to the pane; the images that are
+        // being loaded are gray, as they are displayed
+        if (image_state[i] == IMAGE_STATE_LOADING) {
+            rgba = sdl_color_rgba(GRAY);
+            for (y = dest->y; y < dest->y + dest->h; y++) {
+                p = frame + ((size_t)y * width + dest->x) * BYTES_PER_PIXEL;
+                for (x = 0; x < dest->w; x++, p += BYTES_PER_PIXEL) {
+                    for (c = 0; c < 4; c++) {
+                        p[c] = ((rgba >> (24 - 8 * c)) & 0xff) * 257;
+                    }
+                }
+            }
+        } else if (image_w[i] != 0 && (pixels16 = image_decode_16bit(i, &w, &h)) != NULL) {
+            if (resample_16(pixels16, w, h, 
+                            w * image_crop[i].x / 100, h * image_crop[i].y / 100,
+                            w * image_crop[i].w / 100, h * image_crop[i].h / 100,
+                            frame + ((size_t)dest->y * width + dest->x) * BYTES_PER_PIXEL,
+                            dest->w, dest->h, width, linear_enabled) != 0)
+            {
+                ERROR("resample %s failed\n", image_filename[i]);
+            }
+            free(pixels16);
+        }
+
+        // draw the border, PANE_BORDER_WIDTH pixels inside the edges of pane_full
+        if (border_color != NO_BORDER) {
+            rgba = sdl_color_rgba(border_color);
+            for (c = 0; c < 4; c++) {
+                color[c] = ((rgba >> (24 - 8 * c)) & 0xff) * 257;
+            }
+            for (y = r->y; y < r->y + r->h; y++) {
+                p = frame + ((size_t)y * width + r->x) * BYTES_PER_PIXEL;
+                for (x = 0; x < r->w; x++, p += BYTES_PER_PIXEL) {
+                    if (x < PANE_BORDER_WIDTH || x >= r->w - PANE_BORDER_WIDTH ||
+                        y < r->y + PANE_BORDER_WIDTH || y >= r->y + r->h - PANE_BORDER_WIDTH) 
+                    {
+                        memcpy(p, color, sizeof(color));
+                    }
+                }
+            }
+        }
+    }
+    STATS_SPAN_END(STATS_STAGE_COMPOSITE, -1, start);
+
+    if (write_png_file16(file_name, frame, width, height, icc_profile, icc_profile_len) != 0) {
+        ERROR("write_png_file16 %s failed\n", file_name);
+    } else if (flash_display) {
+        sdl_flash_display();
+    }
+    free(frame);
+}
+
+// -----------------  AUTO CROP  ----------------------------------------------------------------
+
+// crop the images that are auto cropped to the aspect ratio of their pane; 
+// the crop is chosen again only when the pane aspect ratio has changed, or the
+// image's profile has just been installed; while the cached texture is stale, 
+// such as while the window is being resized, the crop is not changed, so that 
+// the cached texture is not rebuilt for each new window size
+static void image_autocrop_apply(void)
+{
+    int32_t  i;
+    double   aspect;
+    crop_t   c;
+    rect_t * texture_dest_pane;
+
+    for (i = 0; i < max_image; i++) {
+        if (!image_autocrop[i] || image_autocrop_profile[i] == NULL || cached_stale[i]) {
+            continue;
+        }
+
+        texture_dest_pane = (border_color == NO_BORDER ? &pane_full[i] : &pane[i]);
+        if (texture_dest_pane->w <= 0 || texture_dest_pane->h <= 0) {
+            continue;
+        }
+        aspect = (double)texture_dest_pane->w / texture_dest_pane->h;
+        if (aspect == image_autocrop_aspect[i]) {
+            continue;
+        }
+        image_autocrop_aspect[i] = aspect;
+
+        autocrop_select(image_autocrop_profile[i], aspect, &c.x, &c.y, &c.w, &c.h);
+        if (memcmp(&c, &image_crop[i], sizeof(crop_t)) != 0) {
+            image_crop[i] = c;
+            cached_texture_invalidate(i);
+        }
+    }
+}
+
+// -----------------  STATS REPORT  -------------------------------------------------------------
+
+static void stats_report(char ** image_name)
+{
+    if (stats_summary) {
+        stats_print_summary();
+    }
+    if (stats_json_filename) {
+        if (stats_write_json(stats_json_filename, image_name, max_image) == 0) {
+            INFO("wrote stats to %s\n", stats_json_filename);
+        }
+    }
+    if (trace_filename) {
+        if (stats_write_trace(trace_filename, image_name, max_image) == 0) {
+            INFO("wrote trace to %s\n", trace_filename);
+        }
+    }
+}
+
 // -----------------  DRAW IMAGES  --------------------------------------------------------------
 
 void draw_images(void)
 {
     static int32_t i;
+    uint64_t composite_start, frame_start;
+    int32_t  win_width, win_height;
+    rect_t   frame_rect;
+
+    frame_start = microsec_timer();
+    composite_start = STATS_SPAN_BEGIN();
+
+    // if the window size has changed then create a new frame_texture
+    sdl_get_state(&win_width, &win_height, NULL);
+    if (frame_texture == NULL || frame_width != win_width || frame_height != win_height) {
+        sdl_destroy_texture(frame_texture);
+        frame_texture = sdl_create_target_texture(win_width, win_height);
+        frame_width = win_width;
+        frame_height = win_height;
+        frame_redraw_all = true;
+    }
 
-    sdl_display_init();
-    for (i = 0; i < max_pane; i++) {
+    // render the dirty panes to the frame_texture, or all panes if frame_redraw_all
+    sdl_set_render_target(frame_texture);
+    if (frame_redraw_all) {
+        sdl_display_init();
+    }
+    frame_panes_drawn = 0;
+    for (i = 0; i < max_image; i++) {
         rect_t * texture_dest_pane = (border_color == NO_BORDER ? &pane_full[i] : &pane[i]);
 
+        // if this pane doesn't need to be rendered again then continue
+        if (!frame_redraw_all && !pane_dirty[i]) {
+            continue;
+        }
+
+        // a pane that has no area, such as the pane of an image that did not fit 
+        // in the mosaic layout, is not rendered
+        if (pane_full[i].w <= 0 || pane_full[i].h <= 0) {
+            continue;
+        }
+        frame_panes_drawn++;
+
+        // clear the pane's prior content; and if the image is being 
+        // loaded then display a placeholder
+        if (!frame_redraw_all) {
+            rect_t r = { 0, 0, pane_full[i].w, pane_full[i].h };
+            sdl_render_fill_rect(&pane_full[i], &r, BLACK);
+        }
+        if (image_state[i] == IMAGE_STATE_LOADING && texture_dest_pane->w > 0 && texture_dest_pane->h > 0) {
+            rect_t r = { 0, 0, texture_dest_pane->w, texture_dest_pane->h };
+            sdl_render_fill_rect(texture_dest_pane, &r, GRAY);
+        }
+
         // if image exists then render it, based on its crop value;
-        // if we have a cached texture then use the cached texture (it is more efficient)
-        if (image[i].width != 0) {
-            if (cached_texture[i] == NULL) {
-                texture_t texture;
-                texture = sdl_create_texture(
-                                nearbyint(image[i].width * image[i].crop.w / 100),
-                                nearbyint(image[i].height * image[i].crop.h / 100));
-                sdl_update_texture(
-                                texture,
-                                image[i].pixels + BYTES_PER_PIXEL *
-                                    (  (int)nearbyint(image[i].width * image[i].crop.x / 100) +
-                                       (int)nearbyint(image[i].height * image[i].crop.y / 100) * image[i].width  ),
-                                image[i].width);
-                sdl_render_texture(texture, texture_dest_pane);
-                sdl_destroy_texture(texture);
-                cached_texture[i] = sdl_create_texture_from_pane_pixels(texture_dest_pane);
+        // if we have a cached texture then use the cached texture (it is more efficient),
+        // otherwise create the cached texture from the crop area of the source texture;
+        // the cached textures that are in the atlas are rendered together, after this loop;
+        // a pane that has no area (such as a tiny window) has nothing to render
+        if (image_w[i] != 0 && texture_dest_pane->w > 0 && texture_dest_pane->h > 0) {
+            if (cached_slot[i].atlas == -1 && cached_texture[i] == NULL) {
+                texture_t source;
+                frect_t   srcrect;
+                uint64_t  start = STATS_SPAN_BEGIN();
+                if (linear_enabled) {
+                    image_crop_rect(i, &image_crop[i], &srcrect);
+                    cached_texture_create_linear(i, &srcrect, texture_dest_pane->w, texture_dest_pane->h);
+                } else if ((source = source_texture_get(i)) != NULL) {
+                    image_crop_rect(i, &image_crop[i], &srcrect);
+                    if (sdl_atlas_alloc(texture_dest_pane->w, texture_dest_pane->h, &cached_slot[i]) == 0) {
+                        sdl_atlas_update(&cached_slot[i], source, &srcrect);
+                        cached_mip_build(i);
+                    } else {
+                        cached_texture[i] = sdl_create_scaled_texture(
+                                    source, &srcrect, texture_dest_pane->w, texture_dest_pane->h);
+                    }
+                }
+                STATS_SPAN_END(STATS_STAGE_RESAMPLE, i, start);
+            }
+            if (cached_slot[i].atlas != -1 && cached_stale[i]) {
+                sdl_atlas_render(cached_mip_select(i, texture_dest_pane->w, texture_dest_pane->h), 
+                                 texture_dest_pane);
+            } else if (cached_slot[i].atlas != -1) {
+                sdl_atlas_render(&cached_slot[i], texture_dest_pane);
             } else {
                 sdl_render_texture(cached_texture[i], texture_dest_pane);
             }
         }
+    }
+    sdl_atlas_render_flush();
 
-        // if a border is needed then display the border
-        if (i < max_image && border_color != NO_BORDER) {
-            sdl_render_pane_border(&pane_full[i], border_color);
-        }
+    // the pixels of the images whose cached textures were just created may no 
+    // longer be needed; if over the memory budget, then free them
+    image_mem_budget_enforce();
 
-        // if crop is enabled for the image currently being processed then 
-        // draw the crop rectangle
-        if (crop_enabled && i == crop_idx) {
-            rect_t r;
-            r.x = texture_dest_pane->w * crop.x / 100;
-            r.y = texture_dest_pane->h * crop.y / 100;
-            r.w = texture_dest_pane->w * crop.w / 100;
-            r.h = texture_dest_pane->h * crop.h / 100;
-            sdl_render_rect(texture_dest_pane, &r, 1, BLACK);
+    // if a border is needed then display the borders of the panes just rendered
+    if (border_color != NO_BORDER) {
+        for (i = 0; i < max_image; i++) {
+            if ((frame_redraw_all || pane_dirty[i]) && pane_full[i].w > 0 && pane_full[i].h > 0) {
+                sdl_render_pane_border(&pane_full[i], border_color);
+            }
+            pane_dirty[i] = false;
         }
+    } else {
+        memset(pane_dirty, 0, max_image * sizeof(bool));
+    }
+    frame_redraw_all = false;
+
+    // copy the frame_texture to the window
+    sdl_set_render_target(NULL);
+    sdl_display_init();
+    frame_rect.x = 0;
+    frame_rect.y = 0;
+    frame_rect.w = frame_width;
+    frame_rect.h = frame_height;
+    sdl_render_texture(frame_texture, &frame_rect);
+
+    // if crop is enabled then draw the crop rectangle over the 
+    // image currently being cropped, and the zoomed preview of the crop area
+    if (crop_enabled) {
+        rect_t * texture_dest_pane = (border_color == NO_BORDER ? &pane_full[crop_idx] : &pane[crop_idx]);
+        rect_t r;
+        r.x = texture_dest_pane->w * crop.x / 100;
+        r.y = texture_dest_pane->h * crop.y / 100;
+        r.w = texture_dest_pane->w * crop.w / 100;
+        r.h = texture_dest_pane->h * crop.h / 100;
+        sdl_render_rect(texture_dest_pane, &r, 1, BLACK);
+        draw_crop_preview(texture_dest_pane);
     }
+
+    // draw the debug overlay, this shows the stats for the prior frames
+    if (debug_overlay) {
+        draw_debug_overlay(&frame_rect);
+    }
+
     sdl_display_present();
+    STATS_SPAN_END(STATS_STAGE_COMPOSITE, -1, composite_start);
+
+    // save the time taken to render this frame
+    frame_time[frame_count % MAX_FRAME_TIME] = microsec_timer() - frame_start;
+    frame_count++;
+}
+
+// draw the crop area of the image being cropped, as it will appear once the crop is 
+// applied; this is rendered from the source texture using the crop area as the source
+// rectangle, so it follows the crop area adjustments without uploading pixels
+static void draw_crop_preview(rect_t * crop_pane)
+{
+    texture_t source;
+    crop_t    c;
+    frect_t   srcrect;
+    rect_t    dstrect, r;
+    int32_t   w, h;
+
+    if (image_w[crop_idx] == 0 || (source = source_texture_get(crop_idx)) == NULL) {
+        return;
+    }
+
+    // the preview is the size of the pane, reduced if needed to fit in half the window, 
+    // and is located in the window corner that is furthest from the pane
+    w = crop_pane->w;
+    h = crop_pane->h;
+    if (w > frame_width / 2) {
+        h = (int64_t)h * (frame_width / 2) / w;
+        w = frame_width / 2;
+    }
+    if (h > frame_height / 2) {
+        w = (int64_t)w * (frame_height / 2) / h;
+        h = frame_height / 2;
+    }
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    dstrect.w = w;
+    dstrect.h = h;
+    dstrect.x = (crop_pane->x + crop_pane->w / 2 < frame_width / 2 ? frame_width - w : 0);
+    dstrect.y = (crop_pane->y + crop_pane->h / 2 < frame_height / 2 ? frame_height - h : 0);
+
+    // render the crop area, and a border around the preview
+    c = crop_combine(&image_crop[crop_idx], &crop);
+    image_crop_rect(crop_idx, &c, &srcrect);
+    sdl_render_texture_src(source, &srcrect, &dstrect);
+
+    r.x = 0;
+    r.y = 0;
+    r.w = w;
+    r.h = h;
+    sdl_render_rect(&dstrect, &r, 2, WHITE);
+}
+
+static void draw_debug_overlay(rect_t * frame_rect)
+{
+    int32_t  i, n;
+    uint64_t sum = 0, max = 0, last;
+    char     str[100];
+
+    if (frame_count == 0) {
+        return;
+    }
+
+    n = (frame_count < MAX_FRAME_TIME ? frame_count : MAX_FRAME_TIME);
+    for (i = 0; i < n; i++) {
+        sum += frame_time[i];
+        if (frame_time[i] > max) {
+            max = frame_time[i];
+        }
+    }
+    last = frame_time[(frame_count - 1) % MAX_FRAME_TIME];
+
+    sprintf(str, "FRAME %" PRIu64 " PANES %d/%d LOADING %d", 
+            frame_count, frame_panes_drawn, max_image, images_loading);
+    sdl_render_text(frame_rect, 0, 0, 0, str, WHITE, BLACK);
+    sprintf(str, "LAST %.2f MS", last / 1000.);
+    sdl_render_text(frame_rect, 1, 0, 0, str, WHITE, BLACK);
+    sprintf(str, "AVG  %.2f MS", (double)sum / n / 1000.);
+    sdl_render_text(frame_rect, 2, 0, 0, str, WHITE, BLACK);
+    sprintf(str, "MAX  %.2f MS", max / 1000.);
+    sdl_render_text(frame_rect, 3, 0, 0, str, WHITE, BLACK);
 }
 
 // -----------------  MULTIPLE LAYOUT SUPPORT  --------------------------------------------
@@ -799,14 +2370,19 @@ static void layout_init(
     int32_t * min_cols, int32_t * max_cols)                           // out
 {
     int32_t rows;
-
-    // determine valid cols range
-    if (layout == LAYOUT_EQUAL_SIZE) {
+    bool    win_height_supplied = false;
+
+    // determine valid cols range; 
+    // the max_cols is increased for large numbers of images, to support
+    // creating image walls from many thumbnails
+    if (layout == LAYOUT_EQUAL_SIZE || layout == LAYOUT_JUSTIFIED_ROWS ||
+        layout == LAYOUT_MOSAIC || layout == LAYOUT_TEMPLATE)
+    {
         *min_cols = 1;
-        *max_cols = 10;
+        *max_cols = (max_image > 10 ? max_image : 10);
     } else if (layout == LAYOUT_FIRST_IMAGE_DOUBLE_SIZE) {
         *min_cols = 2;
-        *max_cols = 10;
+        *max_cols = (max_image > 10 ? max_image : 10);
     } else {
         FATAL("layout %d not supported\n", layout);
     }
@@ -822,7 +2398,9 @@ static void layout_init(
             FATAL("cols %d not in ragne %d - %d\n", *cols, *min_cols, *max_cols);
         }
     } else {
-        if (layout == LAYOUT_EQUAL_SIZE) {
+        if (layout == LAYOUT_EQUAL_SIZE || layout == LAYOUT_JUSTIFIED_ROWS ||
+            layout == LAYOUT_MOSAIC || layout == LAYOUT_TEMPLATE)
+        {
             *cols = (max_image == 1 ? 1 :
                      max_image == 2 ? 2 :
                      max_image == 3 ? 3 :
@@ -834,8 +2412,12 @@ static void layout_init(
         }
     }
 
-    // determine rows;  rows is just used local to this routine
-    if (layout == LAYOUT_EQUAL_SIZE) {
+    // determine rows;  rows is just used local to this routine;
+    // for the justified rows, mosaic and template layouts, the initial window size 
+    // is based on the images having DEFAULT_ASPECT_RATIO
+    if (layout == LAYOUT_EQUAL_SIZE || layout == LAYOUT_JUSTIFIED_ROWS ||
+        layout == LAYOUT_MOSAIC || layout == LAYOUT_TEMPLATE)
+    {
         rows = ceil((double)max_image / (*cols));
     } else { // LAYOUT_FIRST_IMAGE_DOUBLE_SIZE
         int32_t images_in_first_2_rows = 1 + 2 * ((*cols) - 2);
@@ -846,6 +2428,18 @@ static void layout_init(
         }
     }
 
+    // for the template layout, when the image dims and window height are not 
+    // supplied, the window size is from the template's SIZE statement; if just the 
+    // window width is supplied then the window height is based on the SIZE aspect ratio
+    if (layout == LAYOUT_TEMPLATE && layout_template.width != 0 && 
+        image_width == 0 && *win_height == 0) 
+    {
+        if (*win_width == 0) {
+            *win_width = layout_template.width;
+        }
+        *win_height = (double)(*win_width) * layout_template.height / layout_template.width;
+    }
+
     // determine win_width, win_height ...
     // if both win_width and win_height are not supplied
     //    if both image_width and image_height are not supplied
@@ -868,6 +2462,29 @@ static void layout_init(
         *win_height = image_height * rows;
     } else if (*win_width != 0 && *win_height == 0) {
         *win_height = (double)(*win_width) / DEFAULT_ASPECT_RATIO * rows / (*cols);
+    } else {
+        win_height_supplied = true;
+    }
+
+    // for the justified rows layout, if the window height was not supplied then it
+    // is determined from the aspect ratios of the images, so that the rows fill the
+    // window width
+    if (layout == LAYOUT_JUSTIFIED_ROWS && !win_height_supplied) {
+        double  * aspect = calloc(max_image, sizeof(double));
+        rect_t  * rect   = calloc(max_image, sizeof(rect_t));
+        int32_t   width_used, height_used;
+
+        if (!aspect || !rect) {
+            FATAL("allocate justified rows layout failed, max_image=%d\n", max_image);
+        }
+        layout_get_aspect(max_image, aspect);
+        if (layout_justified_rows(aspect, max_image, rows, *win_width, INT32_MAX,
+                                  rect, &width_used, &height_used) == 0)
+        {
+            *win_height = height_used;
+        }
+        free(aspect);
+        free(rect);
     }
 }
 
@@ -876,9 +2493,30 @@ static void layout_get_panes(
     rect_t * pane, rect_t * pane_full, int32_t * max_pane,                     // out
     int32_t * win_width_used, int32_t * win_height_used)
 {
-    int32_t r, c; 
+    int32_t r, c, i; 
     int32_t rows;
-    int32_t image_width, image_height;
+    int32_t x0, x1, y0, y1;
+
+    // the justified rows and mosaic layouts are done by layout_get_panes_aspect
+    if (layout == LAYOUT_JUSTIFIED_ROWS || layout == LAYOUT_MOSAIC) {
+        layout_get_panes_aspect(max_image, win_width, win_height, cols,
+                                pane, pane_full, max_pane,
+                                win_width_used, win_height_used);
+        return;
+    }
+
+    // the template layout panes are the template's regions scaled to the window size
+    if (layout == LAYOUT_TEMPLATE) {
+        template_get_panes(&layout_template, win_width, win_height, max_image, pane_full);
+        for (i = 0; i < max_image; i++) {
+            sdl_init_pane(&pane_full[i], &pane[i], 
+                          pane_full[i].x, pane_full[i].y, pane_full[i].w, pane_full[i].h);
+        }
+        *max_pane = max_image;
+        *win_width_used = win_width;
+        *win_height_used = win_height;
+        return;
+    }
 
     // determine rows;  rows is just used local to this routine
     if (layout == LAYOUT_EQUAL_SIZE) {
@@ -892,21 +2530,21 @@ static void layout_get_panes(
         }
     }
 
-    // determine image_width and image_height;
-    // these are also just used local to this routine
-    image_width = win_width / cols;
-    image_height = win_height / rows;
-
-    // determine pane, pane_full, and max_pane
+    // determine pane, pane_full, and max_pane;
+    // panes are only created for images, so that the pane arrays need
+    // just be max_image in size; the unused panes of the last row are not created;
+    // the pane edges are determined by layout_grid_edge, so the remainder pixels
+    // of win_width / cols and win_height / rows are distributed across the panes
     if (layout == LAYOUT_EQUAL_SIZE) {
         *max_pane = 0;
-        for (r = 0; r < rows; r++) {
-            for (c = 0; c < cols; c++) {
+        for (r = 0; r < rows && *max_pane < max_image; r++) {
+            for (c = 0; c < cols && *max_pane < max_image; c++) {
+                x0 = layout_grid_edge(win_width, cols, c);
+                x1 = layout_grid_edge(win_width, cols, c+1);
+                y0 = layout_grid_edge(win_height, rows, r);
+                y1 = layout_grid_edge(win_height, rows, r+1);
                 sdl_init_pane(&pane_full[*max_pane], &pane[*max_pane],
-                              image_width * c,
-                              image_height * r,
-                              image_width,
-                              image_height);
+                              x0, y0, x1 - x0, y1 - y0);
                 (*max_pane)++;
             }
         }
@@ -916,29 +2554,122 @@ static void layout_get_panes(
         // first pane is double size
         sdl_init_pane(&pane_full[*max_pane], &pane[*max_pane],
                       0, 0,
-                      2 * image_width,
-                      2 * image_height);
+                      layout_grid_edge(win_width, cols, 2),
+                      layout_grid_edge(win_height, rows, 2));
         (*max_pane)++;
 
         // init the rest of the panes
-        for (r = 0; r < rows; r++) {
-            for (c = 0; c < cols; c++) {
+        for (r = 0; r < rows && *max_pane < max_image; r++) {
+            for (c = 0; c < cols && *max_pane < max_image; c++) {
                 if (r <= 1 && c <= 1) {
                     continue;
                 }
+                x0 = layout_grid_edge(win_width, cols, c);
+                x1 = layout_grid_edge(win_width, cols, c+1);
+                y0 = layout_grid_edge(win_height, rows, r);
+                y1 = layout_grid_edge(win_height, rows, r+1);
                 sdl_init_pane(&pane_full[*max_pane], &pane[*max_pane],
-                              image_width * c,
-                              image_height * r,
-                              image_width,
-                              image_height);
+                              x0, y0, x1 - x0, y1 - y0);
                 (*max_pane)++;
             }
         }
     }
 
-    // determine win_width_used and win_height_used, these
-    // may be slightly less than win_width/height
-    *win_width_used = image_width * cols;
-    *win_height_used = image_height * rows;
+    // the panes fill the window
+    *win_width_used = win_width;
+    *win_height_used = win_height;
+}
+
+// return the position of edge i, of n equal divisions of size; the divisions
+// differ in size by at most 1 pixel, and the last edge is at size
+static int32_t layout_grid_edge(int32_t size, int32_t n, int32_t i)
+{
+    return (int64_t)size * i / n;
+}
+
+// the justified rows and mosaic layouts use the aspect ratio of each image, including 
+// its crop; the layout is computed again only when the aspect ratios, window size, 
+// or cols have changed
+static void layout_get_panes_aspect(
+    int32_t max_image, int32_t win_width, int32_t win_height, int32_t cols,    // in
+    rect_t * pane, rect_t * pane_full, int32_t * max_pane,                     // out
+    int32_t * win_width_used, int32_t * win_height_used)
+{
+    static double  * aspect;
+    static double  * aspect_prior;
+    static rect_t  * rect;
+    static int32_t   win_width_prior, win_height_prior, cols_prior;
+    static int32_t   width_used, height_used;
+    int32_t i, rows;
+    double  fill_ratio;
+
+    // allocate
+    if (aspect == NULL) {
+        aspect       = calloc(max_image, sizeof(double));
+        aspect_prior = calloc(max_image, sizeof(double));
+        rect         = calloc(max_image, sizeof(rect_t));
+        if (!aspect || !aspect_prior || !rect) {
+            FATAL("allocate layout failed, max_image=%d\n", max_image);
+        }
+    }
+
+    // determine the aspect ratio of each image
+    layout_get_aspect(max_image, aspect);
+
+    // if the aspect ratios, window size or cols have changed then
+    // compute the layout
+    if (memcmp(aspect, aspect_prior, max_image * sizeof(double)) != 0 ||
+        win_width != win_width_prior || win_height != win_height_prior || cols != cols_prior)
+    {
+        if (layout == LAYOUT_JUSTIFIED_ROWS) {
+            rows = ceil((double)max_image / cols);
+            if (layout_justified_rows(aspect, max_image, rows, win_width, win_height,
+                                      rect, &width_used, &height_used) != 0)
+            {
+                FATAL("layout_justified_rows failed, max_image=%d rows=%d\n", max_image, rows);
+            }
+        } else { // LAYOUT_MOSAIC
+            // if the layout fails, such as when the window has no area, then 
+            // the images are given empty panes, which are not rendered
+            if (layout_mosaic(aspect, max_image, win_width, win_height,
+                              rect, &width_used, &height_used, &fill_ratio) != 0)
+            {
+                DEBUG("layout_mosaic failed, max_image=%d win=%dx%d\n", 
+                      max_image, win_width, win_height);
+                memset(rect, 0, max_image * sizeof(rect_t));
+            }
+            DEBUG("mosaic layout %dx%d, fill ratio %.3f\n", width_used, height_used, fill_ratio);
+        }
+        memcpy(aspect_prior, aspect, max_image * sizeof(double));
+        win_width_prior = win_width;
+        win_height_prior = win_height;
+        cols_prior = cols;
+    }
+
+    // return the panes
+    for (i = 0; i < max_image; i++) {
+        sdl_init_pane(&pane_full[i], &pane[i], rect[i].x, rect[i].y, rect[i].w, rect[i].h);
+    }
+    *max_pane = max_image;
+    *win_width_used = width_used;
+    *win_height_used = height_used;
+}
+
+// return the aspect ratio of each image, including its crop; the dimensions from
+// the image file header are used for the images that have not been loaded, and
+// DEFAULT_ASPECT_RATIO is used if these are not available
+static void layout_get_aspect(int32_t max_image, double * aspect)
+{
+    int32_t i;
+
+    for (i = 0; i < max_image; i++) {
+        if (image_w[i] != 0 && image_h[i] != 0) {
+            aspect[i] = (image_w[i] * image_crop[i].w) / (image_h[i] * image_crop[i].h);
+        } else if (image_probe_w[i] != 0 && image_probe_h[i] != 0) {
+            aspect[i] = (image_probe_w[i] * image_crop[i].w) / (image_probe_h[i] * image_crop[i].h);
+        } else {
+            aspect[i] = DEFAULT_ASPECT_RATIO;
+        }
+    }
 }
 
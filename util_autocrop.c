@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "util_autocrop.h"
+#include "util_misc.h"
+
+//
+// The image is reduced to a luminance map, at most AUTOCROP_MAP_DIM on its long 
+// side, and the energy of each map cell is its gradient magnitude. The crop that
+// fills a pane is the full height or the full width of the image, so just the 
+// cumulative energy of the map columns and rows are needed to find the crop
+// position with the most energy; these are retained in the profile.
+//
+// The image is sampled at no more than AUTOCROP_MAX_SAMPLE pixels per map cell 
+// in each direction, so the cost is bounded when the full image is supplied 
+// rather than the preview. The inner loops are kept simple so the compiler can 
+// vectorize them.
+//
+
+//
+// defines
+//
+
+#define AUTOCROP_MAP_DIM     256
+#define AUTOCROP_MAX_SAMPLE  4
+
+//
+// typedefs
+//
+
+//
+// variables
+//
+
+//
+// prototypes
+//
+
+static double cumulative(double * sum, int32_t n, double pos);
+
+// -----------------  AUTOCROP API  --------------------------------------------
+
+autocrop_profile_t * autocrop_profile_create(uint8_t * pixels, int32_t width, int32_t height)
+{
+    autocrop_profile_t * prof;
+    int32_t  mw, mh, x, y, mx, my, step_x, step_y, gx, gy;
+    int32_t  * map_x = NULL;
+    uint32_t * lum = NULL;
+    uint16_t * cnt = NULL;
+    uint8_t  * p;
+    double     scale, e;
+
+    if (width <= 0 || height <= 0) {
+        return NULL;
+    }
+
+    // determine the energy map dimensions
+    scale = (double)AUTOCROP_MAP_DIM / (width > height ? width : height);
+    if (scale > 1) {
+        scale = 1;
+    }
+    mw = nearbyint(width * scale);
+    mh = nearbyint(height * scale);
+    if (mw < 1) mw = 1;
+    if (mh < 1) mh = 1;
+
+    // allocate the profile, with its cumulative sum arrays following it
+    prof = calloc(1, sizeof(autocrop_profile_t) + (mw + 1 + mh + 1) * sizeof(double));
+    map_x = malloc(width * sizeof(int32_t));
+    lum = calloc(mw * mh, sizeof(uint32_t));
+    cnt = calloc(mw * mh, sizeof(uint16_t));
+    if (prof == NULL || map_x == NULL || lum == NULL || cnt == NULL) {
+        ERROR("allocate autocrop profile failed, %dx%d\n", width, height);
+        free(prof);
+        prof = NULL;
+        goto done;
+    }
+    prof->aspect = (double)width / height;
+    prof->w = mw;
+    prof->h = mh;
+    prof->col_sum = (double*)(prof + 1);
+    prof->row_sum = prof->col_sum + mw + 1;
+
+    // average the luminance of the sampled pixels of each map cell; 
+    // the luminance is the rec 601 weighting, scaled by 256
+    step_x = width / mw / AUTOCROP_MAX_SAMPLE;
+    step_y = height / mh / AUTOCROP_MAX_SAMPLE;
+    if (step_x < 1) step_x = 1;
+    if (step_y < 1) step_y = 1;
+    for (x = 0; x < width; x += step_x) {
+        map_x[x] = (int64_t)x * mw / width;
+    }
+    for (y = 0; y < height; y += step_y) {
+        uint32_t * lum_row = &lum[((int64_t)y * mh / height) * mw];
+        uint16_t * cnt_row = &cnt[((int64_t)y * mh / height) * mw];
+        p = pixels + (int64_t)y * width * 4;
+        for (x = 0; x < width; x += step_x) {
+            lum_row[map_x[x]] += 77 * p[4*x+0] + 150 * p[4*x+1] + 29 * p[4*x+2];
+            cnt_row[map_x[x]]++;
+        }
+    }
+    for (mx = 0; mx < mw * mh; mx++) {
+        lum[mx] = (cnt[mx] ? lum[mx] / cnt[mx] : 0);
+    }
+
+    // the energy of each map cell is the gradient magnitude, |dx| + |dy| using 
+    // central differences that are clamped at the map edges; this is summed
+    // by column and by row
+    for (my = 0; my < mh; my++) {
+        uint32_t * up   = &lum[(my > 0 ? my-1 : my) * mw];
+        uint32_t * down = &lum[(my < mh-1 ? my+1 : my) * mw];
+        uint32_t * row  = &lum[my * mw];
+        double     row_energy = 0;
+        for (mx = 0; mx < mw; mx++) {
+            gx = (int32_t)row[mx < mw-1 ? mx+1 : mx] - (int32_t)row[mx > 0 ? mx-1 : mx];
+            gy = (int32_t)down[mx] - (int32_t)up[mx];
+            e = abs(gx) + abs(gy);
+            prof->col_sum[mx+1] += e;
+            row_energy += e;
+        }
+        prof->row_sum[my+1] = row_energy;
+    }
+
+    // convert the column and row energies to cumulative sums
+    for (mx = 0; mx < mw; mx++) {
+        prof->col_sum[mx+1] += prof->col_sum[mx];
+    }
+    for (my = 0; my < mh; my++) {
+        prof->row_sum[my+1] += prof->row_sum[my];
+    }
+
+done:
+    free(map_x);
+    free(lum);
+    free(cnt);
+    return prof;
+}
+
+void autocrop_select(autocrop_profile_t * prof, double aspect, 
+                     double * x, double * y, double * w, double * h)
+{
+    double  * sum;
+    int32_t   n, k;
+    double    frac, win, pos, center, energy, best_pos, best_energy;
+
+    // the crop is the full height of the image if the aspect ratio is narrower
+    // than the image, otherwise it is the full width
+    if (aspect < prof->aspect) {
+        frac = aspect / prof->aspect;
+        sum = prof->col_sum;
+        n = prof->w;
+    } else {
+        frac = prof->aspect / aspect;
+        sum = prof->row_sum;
+        n = prof->h;
+    }
+
+    // find the position, in map cells, of the window with the most energy; the 
+    // positions are at each map cell and at the far end; of equal energies the 
+    // one closest to center is chosen, so a featureless image is center cropped
+    win = frac * n;
+    center = (n - win) / 2;
+    best_pos = center;
+    best_energy = -1;
+    for (k = 0; k <= (int32_t)(n - win) + 1; k++) {
+        pos = (k <= n - win ? k : n - win);
+        energy = cumulative(sum, n, pos + win) - cumulative(sum, n, pos);
+        if (energy > best_energy ||
+            (energy == best_energy && fabs(pos - center) < fabs(best_pos - center)))
+        {
+            best_energy = energy;
+            best_pos = pos;
+        }
+    }
+
+    // return the crop in percent
+    if (aspect < prof->aspect) {
+        *x = 100 * best_pos / n;
+        *y = 0;
+        *w = 100 * frac;
+        *h = 100;
+    } else {
+        *x = 0;
+        *y = 100 * best_pos / n;
+        *w = 100;
+        *h = 100 * frac;
+    }
+}
+
+// return the cumulative sum at a fractional position, interpolating between 
+// the whole cells
+static double cumulative(double * sum, int32_t n, double pos)
+{
+    int32_t i = pos;
+
+    if (i >= n) {
+        return sum[n];
+    }
+    return sum[i] + (pos - i) * (sum[i+1] - sum[i]);
+}
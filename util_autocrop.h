@@ -0,0 +1,46 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __UTIL_AUTOCROP_H__
+#define __UTIL_AUTOCROP_H__
+
+// the energy profile of an image, used to choose a crop; this is small, so
+// it is retained after the pixels it was computed from are freed
+typedef struct {
+    double   aspect;     // width / height of the image
+    int32_t  w;          // dimensions of the energy map
+    int32_t  h;
+    double * col_sum;    // col_sum[x] is the energy of the map columns 0 .. x-1, w+1 entries
+    double * row_sum;    // row_sum[y] is the energy of the map rows 0 .. y-1, h+1 entries
+} autocrop_profile_t;
+
+// compute the energy profile of an image; pixels are 4 bytes per pixel, with 
+// the red, green and blue bytes first; returns NULL if allocation fails;
+// the profile is freed by free()
+autocrop_profile_t * autocrop_profile_create(uint8_t * pixels, int32_t width, int32_t height);
+
+// choose the largest crop with the aspect ratio, whose position has the most 
+// energy; the crop x,y,w,h are returned in percent of the image dimensions
+void autocrop_select(autocrop_profile_t * prof, double aspect, 
+                     double * x, double * y, double * w, double * h);
+
+#endif
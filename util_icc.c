@@ -0,0 +1,679 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "util_icc.h"
+#include "util_misc.h"
+
+//
+// documentation:
+//   http://www.color.org/specification/ICC1v43_2010-12.pdf
+//
+// Just RGB matrix / TRC profiles are supported, such as sRGB, Display P3 and 
+// AdobeRGB. An input to output transform is a 3D lookup table, which is created 
+// once for each distinct input profile and saved in a small cache. The table 
+// is applied using tetrahedral interpolation. When the transform is the 
+// identity, for example an sRGB input and the default sRGB output, the pixels 
+// are not changed.
+//
+
+//
+// defines
+//
+
+#define ICC_LUT_DIM       33
+#define ICC_INV_TRC_SIZE  4096
+#define MAX_ICC_CACHE     16
+
+#define TRC_PARA   1   // parametric curve, param[0] is the gamma
+#define TRC_TABLE  2   // sampled curve, table has max_table big endian uint16 entries
+
+#define GET_BE16(p) (((p)[0] << 8) | (p)[1])
+#define GET_BE32(p) (((uint32_t)(p)[0] << 24) | ((p)[1] << 16) | ((p)[2] << 8) | (p)[3])
+#define GET_S15F16(p) ((int32_t)GET_BE32(p) / 65536.0)
+
+//
+// typedefs
+//
+
+typedef struct {
+    int32_t   type;
+    int32_t   para_type;   // the ICC parametric function type 0 - 4
+    double    param[7];
+    int32_t   max_table;
+    uint8_t * table;
+} trc_t;
+
+typedef struct {
+    double matrix[3][3];   // rgb to pcs XYZ; column c is the XYZ of primary c
+    trc_t  trc[3];
+} icc_profile_t;
+
+typedef struct {
+    int32_t  refcnt;     // the cache's reference and each icc_convert in progress
+    bool     identity;
+    uint16_t lut[ICC_LUT_DIM * ICC_LUT_DIM * ICC_LUT_DIM * 3];
+} icc_transform_t;
+
+typedef struct {
+    uint64_t          hash;
+    int32_t           len;
+    icc_transform_t * transform;
+} icc_cache_t;
+
+//
+// variables
+//
+
+static icc_profile_t   icc_out;
+static bool            icc_out_srgb = true;
+static bool            icc_out_valid;       // false until the tables below are initialized
+static double          icc_out_inv_matrix[3][3];
+static uint16_t        icc_out_inv_trc[3][ICC_INV_TRC_SIZE+1];
+
+static pthread_mutex_t icc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static icc_cache_t     icc_cache[MAX_ICC_CACHE];
+static int32_t         max_icc_cache;
+
+//
+// prototypes
+//
+
+static int32_t icc_parse(uint8_t * data, int32_t len, icc_profile_t * p);
+static int32_t icc_parse_trc(uint8_t * data, int32_t len, uint32_t off, uint32_t size, trc_t * trc);
+static void icc_srgb(icc_profile_t * p);
+static int32_t icc_output_init(void);
+static double trc_eval(trc_t * t, double x);
+static int32_t matrix_invert(double m[3][3], double inv[3][3]);
+static icc_transform_t * icc_transform_create(icc_profile_t * in);
+static icc_transform_t * icc_transform_get(uint8_t * icc_profile, int32_t icc_profile_len);
+static void icc_transform_put(icc_transform_t * t);
+static void icc_transform_put_locked(icc_transform_t * t);
+static void icc_transform_apply(icc_transform_t * t, uint8_t * pixels, int64_t max_pixel);
+static void icc_transform_apply16(icc_transform_t * t, uint16_t * pixels, int64_t max_pixel);
+static uint64_t icc_hash(uint8_t * data, int32_t len);
+
+// -----------------  ICC API  -------------------------------------------------
+
+int32_t icc_set_output_profile(uint8_t * data, int32_t len)
+{
+    int32_t k, ret;
+
+    pthread_mutex_lock(&icc_cache_mutex);
+
+    // parse the output profile, NULL is sRGB
+    if (data == NULL) {
+        icc_srgb(&icc_out);
+        icc_out_srgb = true;
+        ret = icc_output_init();
+    } else if (icc_parse(data, len, &icc_out) == 0) {
+        icc_out_srgb = false;
+        ret = icc_output_init();
+    } else {
+        icc_srgb(&icc_out);
+        icc_out_srgb = true;
+        icc_output_init();
+        ret = -1;
+    }
+
+    // the cached transforms are to the prior output profile
+    for (k = 0; k < max_icc_cache; k++) {
+        icc_transform_put_locked(icc_cache[k].transform);
+    }
+    max_icc_cache = 0;
+
+    pthread_mutex_unlock(&icc_cache_mutex);
+    return ret;
+}
+
+
+void icc_convert(uint8_t * icc_profile, int32_t icc_profile_len, uint8_t * pixels, int64_t max_pixel)
+{
+    icc_transform_t * t;
+
+    // an input without a profile is sRGB, which needs no conversion to sRGB
+    if (icc_profile == NULL && icc_out_srgb) {
+        return;
+    }
+
+    t = icc_transform_get(icc_profile, icc_profile_len);
+    if (t != NULL) {
+        if (!t->identity) {
+            icc_transform_apply(t, pixels, max_pixel);
+        }
+        icc_transform_put(t);
+    }
+}
+
+void icc_convert16(uint8_t * icc_profile, int32_t icc_profile_len, uint16_t * pixels, int64_t max_pixel)
+{
+    icc_transform_t * t;
+
+    if (icc_profile == NULL && icc_out_srgb) {
+        return;
+    }
+
+    t = icc_transform_get(icc_profile, icc_profile_len);
+    if (t != NULL) {
+        if (!t->identity) {
+            icc_transform_apply16(t, pixels, max_pixel);
+        }
+        icc_transform_put(t);
+    }
+}
+
+// get the transform from the icc_profile to the output profile, from the cache, 
+// or create it; the caller must release the transform with icc_transform_put, 
+// because another thread may evict it from the cache while it is in use
+static icc_transform_t * icc_transform_get(uint8_t * icc_profile, int32_t icc_profile_len)
+{
+    icc_transform_t * t = NULL;
+    icc_profile_t     in;
+    uint64_t          hash;
+    int32_t           i;
+
+    hash = (icc_profile ? icc_hash(icc_profile, icc_profile_len) : 0);
+    pthread_mutex_lock(&icc_cache_mutex);
+    if (!icc_out_valid) {
+        icc_srgb(&icc_out);
+        icc_output_init();
+    }
+    for (i = 0; i < max_icc_cache; i++) {
+        if (icc_cache[i].hash == hash && icc_cache[i].len == icc_profile_len) {
+            t = icc_cache[i].transform;
+            break;
+        }
+    }
+    if (t == NULL) {
+        if (icc_profile == NULL) {
+            icc_srgb(&in);
+        } else if (icc_parse(icc_profile, icc_profile_len, &in) != 0) {
+            WARN("unsupported icc profile, len=%d, treated as sRGB\n", icc_profile_len);
+            icc_srgb(&in);
+        }
+        t = icc_transform_create(&in);
+        if (t != NULL) {
+            if (max_icc_cache == MAX_ICC_CACHE) {
+                icc_transform_put_locked(icc_cache[--max_icc_cache].transform);
+            }
+            memmove(&icc_cache[1], &icc_cache[0], max_icc_cache * sizeof(icc_cache_t));
+            icc_cache[0].hash = hash;
+            icc_cache[0].len = icc_profile_len;
+            icc_cache[0].transform = t;
+            max_icc_cache++;
+        }
+    }
+    if (t != NULL) {
+        t->refcnt++;
+    }
+    pthread_mutex_unlock(&icc_cache_mutex);
+
+    return t;
+}
+
+// release a reference to the transform, it is freed when it is no longer 
+// in the cache nor in use
+static void icc_transform_put(icc_transform_t * t)
+{
+    pthread_mutex_lock(&icc_cache_mutex);
+    icc_transform_put_locked(t);
+    pthread_mutex_unlock(&icc_cache_mutex);
+}
+
+// the caller must hold icc_cache_mutex
+static void icc_transform_put_locked(icc_transform_t * t)
+{
+    if (--t->refcnt == 0) {
+        free(t);
+    }
+}
+
+int32_t icc_read_file(char * file_name, uint8_t ** data, int32_t * len)
+{
+    FILE * fp;
+    long   size;
+
+    *data = NULL;
+    *len = 0;
+
+    fp = fopen(file_name, "rb");
+    if (fp == NULL) {
+        ERROR("fopen %s, %s\n", file_name, strerror(errno));
+        return -1;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 || size > 0x1000000 ||
+        fseek(fp, 0, SEEK_SET) != 0)
+    {
+        ERROR("%s: invalid size\n", file_name);
+        fclose(fp);
+        return -1;
+    }
+    *data = malloc(size);
+    if (*data == NULL || fread(*data, 1, size, fp) != size) {
+        ERROR("%s: read failed\n", file_name);
+        free(*data);
+        *data = NULL;
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    *len = size;
+    return 0;
+}
+
+// -----------------  PROFILE PARSING  -----------------------------------------
+
+static int32_t icc_parse(uint8_t * data, int32_t len, icc_profile_t * p)
+{
+    static const char * xyz_tag[3] = { "rXYZ", "gXYZ", "bXYZ" };
+    static const char * trc_tag[3] = { "rTRC", "gTRC", "bTRC" };
+    uint32_t max_tag, i, off, size;
+    int32_t  c, found_xyz = 0, found_trc = 0;
+    uint8_t * tag;
+
+    memset(p, 0, sizeof(icc_profile_t));
+
+    // verify the header: the signature, an RGB color space, and an XYZ pcs
+    if (len < 132 || memcmp(data+36, "acsp", 4) != 0 ||
+        memcmp(data+16, "RGB ", 4) != 0 || memcmp(data+20, "XYZ ", 4) != 0)
+    {
+        return -1;
+    }
+
+    // find the colorant and TRC tags
+    max_tag = GET_BE32(data+128);
+    if (max_tag > (len - 132) / 12) {
+        return -1;
+    }
+    for (i = 0; i < max_tag; i++) {
+        tag  = data + 132 + 12 * i;
+        off  = GET_BE32(tag+4);
+        size = GET_BE32(tag+8);
+        if (off > len || size > len - off) {
+            return -1;
+        }
+        for (c = 0; c < 3; c++) {
+            if (memcmp(tag, xyz_tag[c], 4) == 0) {
+                if (size < 20 || memcmp(data+off, "XYZ ", 4) != 0) {
+                    return -1;
+                }
+                p->matrix[0][c] = GET_S15F16(data+off+8);
+                p->matrix[1][c] = GET_S15F16(data+off+12);
+                p->matrix[2][c] = GET_S15F16(data+off+16);
+                found_xyz |= (1 << c);
+            }
+            if (memcmp(tag, trc_tag[c], 4) == 0) {
+                if (icc_parse_trc(data, len, off, size, &p->trc[c]) != 0) {
+                    return -1;
+                }
+                found_trc |= (1 << c);
+            }
+        }
+    }
+
+    return (found_xyz == 7 && found_trc == 7) ? 0 : -1;
+}
+
+static int32_t icc_parse_trc(uint8_t * data, int32_t len, uint32_t off, uint32_t size, trc_t * trc)
+{
+    static const int32_t para_count[5] = { 1, 3, 4, 5, 7 };
+    uint32_t count, i;
+
+    if (size >= 12 && memcmp(data+off, "curv", 4) == 0) {
+        count = GET_BE32(data+off+8);
+        if (count > (size - 12) / 2) {
+            return -1;
+        }
+        if (count == 0) {
+            trc->type = TRC_PARA;
+            trc->param[0] = 1;
+        } else if (count == 1) {
+            trc->type = TRC_PARA;
+            trc->param[0] = GET_BE16(data+off+12) / 256.0;
+        } else {
+            trc->type = TRC_TABLE;
+            trc->max_table = count;
+            trc->table = data + off + 12;
+        }
+        return 0;
+    }
+
+    if (size >= 12 && memcmp(data+off, "para", 4) == 0) {
+        trc->type = TRC_PARA;
+        trc->para_type = GET_BE16(data+off+8);
+        if (trc->para_type > 4 || size < 12 + 4 * para_count[trc->para_type]) {
+            return -1;
+        }
+        for (i = 0; i < para_count[trc->para_type]; i++) {
+            trc->param[i] = GET_S15F16(data+off+12+4*i);
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+// the sRGB profile, with the primaries adapted to the D50 pcs white point
+static void icc_srgb(icc_profile_t * p)
+{
+    static const double matrix[3][3] = { { 0.4360747, 0.3850649, 0.1430804 },
+                                         { 0.2225045, 0.7168786, 0.0606169 },
+                                         { 0.0139322, 0.0971045, 0.7141733 } };
+    int32_t c;
+
+    memset(p, 0, sizeof(icc_profile_t));
+    memcpy(p->matrix, matrix, sizeof(matrix));
+    for (c = 0; c < 3; c++) {
+        p->trc[c].type = TRC_PARA;
+        p->trc[c].para_type = 3;
+        p->trc[c].param[0] = 2.4;
+        p->trc[c].param[1] = 1 / 1.055;
+        p->trc[c].param[2] = 0.055 / 1.055;
+        p->trc[c].param[3] = 1 / 12.92;
+        p->trc[c].param[4] = 0.04045;
+    }
+}
+
+// initialize the inverse of the output profile's matrix and TRCs, which are 
+// used to create the transforms; the caller must hold icc_cache_mutex
+static int32_t icc_output_init(void)
+{
+    int32_t c, k, iter;
+    double  y, lo, hi, mid;
+
+    icc_out_valid = false;
+
+    // invert the output matrix
+    if (matrix_invert(icc_out.matrix, icc_out_inv_matrix) != 0) {
+        ERROR("output profile matrix is singular\n");
+        return -1;
+    }
+
+    // invert the output TRCs, by bisection; the TRCs are non-decreasing
+    for (c = 0; c < 3; c++) {
+        for (k = 0; k <= ICC_INV_TRC_SIZE; k++) {
+            y = (double)k / ICC_INV_TRC_SIZE;
+            lo = 0;
+            hi = 1;
+            for (iter = 0; iter < 24; iter++) {
+                mid = (lo + hi) / 2;
+                if (trc_eval(&icc_out.trc[c], mid) < y) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            icc_out_inv_trc[c][k] = nearbyint(hi * 65535);
+        }
+    }
+
+    icc_out_valid = true;
+    return 0;
+}
+
+// evaluate the TRC, x and the return value are 0 - 1
+static double trc_eval(trc_t * t, double x)
+{
+    double * p = t->param;
+    double   y, pos;
+    int32_t  i;
+
+    if (t->type == TRC_TABLE) {
+        pos = x * (t->max_table - 1);
+        i = pos;
+        if (i >= t->max_table - 1) {
+            return GET_BE16(t->table + 2 * (t->max_table - 1)) / 65535.0;
+        }
+        return (GET_BE16(t->table + 2 * i) + 
+                (pos - i) * (GET_BE16(t->table + 2 * (i+1)) - GET_BE16(t->table + 2 * i))) / 65535.0;
+    }
+
+    switch (t->para_type) {
+    case 0:
+        y = pow(x, p[0]);
+        break;
+    case 1:
+        y = (x >= -p[2] / p[1] ? pow(p[1] * x + p[2], p[0]) : 0);
+        break;
+    case 2:
+        y = (x >= -p[2] / p[1] ? pow(p[1] * x + p[2], p[0]) + p[3] : p[3]);
+        break;
+    case 3:
+        y = (x >= p[4] ? pow(p[1] * x + p[2], p[0]) : p[3] * x);
+        break;
+    default:
+        y = (x >= p[4] ? pow(p[1] * x + p[2], p[0]) + p[5] : p[3] * x + p[6]);
+        break;
+    }
+    return (y < 0 ? 0 : y > 1 ? 1 : y);
+}
+
+static int32_t matrix_invert(double m[3][3], double inv[3][3])
+{
+    double det;
+    int32_t i, j;
+
+    det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+          m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+          m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (fabs(det) < 1e-12) {
+        return -1;
+    }
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            // the cofactor of m[j][i], divided by the determinant
+            int32_t r0 = (j+1) % 3, r1 = (j+2) % 3;
+            int32_t c0 = (i+1) % 3, c1 = (i+2) % 3;
+            inv[i][j] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / det;
+        }
+    }
+    return 0;
+}
+
+// -----------------  TRANSFORM  -----------------------------------------------
+
+// create the lookup table that converts from the input profile to the output 
+// profile: input TRC, input matrix to XYZ, inverse output matrix, and the 
+// inverse output TRC
+static icc_transform_t * icc_transform_create(icc_profile_t * in)
+{
+    icc_transform_t * t;
+    int32_t  i, j, k, c, n;
+    double   rgb[3], lin[3], xyz[3], out, pos;
+    uint16_t * e;
+
+    t = malloc(sizeof(icc_transform_t));
+    if (t == NULL) {
+        ERROR("allocate icc transform failed\n");
+        return NULL;
+    }
+    t->refcnt = 1;
+    t->identity = true;
+
+    e = t->lut;
+    for (i = 0; i < ICC_LUT_DIM; i++) {
+        for (j = 0; j < ICC_LUT_DIM; j++) {
+            for (k = 0; k < ICC_LUT_DIM; k++) {
+                rgb[0] = (double)i / (ICC_LUT_DIM - 1);
+                rgb[1] = (double)j / (ICC_LUT_DIM - 1);
+                rgb[2] = (double)k / (ICC_LUT_DIM - 1);
+                for (c = 0; c < 3; c++) {
+                    lin[c] = trc_eval(&in->trc[c], rgb[c]);
+                }
+                for (c = 0; c < 3; c++) {
+                    xyz[c] = in->matrix[c][0] * lin[0] + in->matrix[c][1] * lin[1] + in->matrix[c][2] * lin[2];
+                }
+                for (c = 0; c < 3; c++) {
+                    out = icc_out_inv_matrix[c][0] * xyz[0] + 
+                          icc_out_inv_matrix[c][1] * xyz[1] + 
+                          icc_out_inv_matrix[c][2] * xyz[2];
+                    out = (out < 0 ? 0 : out > 1 ? 1 : out);
+                    pos = out * ICC_INV_TRC_SIZE;
+                    n = pos;
+                    if (n >= ICC_INV_TRC_SIZE) {
+                        e[c] = icc_out_inv_trc[c][ICC_INV_TRC_SIZE];
+                    } else {
+                        e[c] = nearbyint(icc_out_inv_trc[c][n] + 
+                                         (pos - n) * (icc_out_inv_trc[c][n+1] - icc_out_inv_trc[c][n]));
+                    }
+
+                    // the transform is the identity if each entry is within
+                    // half of an 8 bit step of its input
+                    if (fabs(e[c] - rgb[c] * 65535) > 65535 / 255 / 2) {
+                        t->identity = false;
+                    }
+                }
+                e += 3;
+            }
+        }
+    }
+
+    return t;
+}
+
+// apply the lookup table using tetrahedral interpolation; the fractions within
+// the lookup table cell are in units of 1/255
+static void icc_transform_apply(icc_transform_t * t, uint8_t * pixels, int64_t max_pixel)
+{
+    const int32_t  s_r = ICC_LUT_DIM * ICC_LUT_DIM * 3;
+    const int32_t  s_g = ICC_LUT_DIM * 3;
+    const int32_t  s_b = 3;
+    int64_t        n;
+    int32_t        c, pos, ir, ig, ib, fr, fg, fb;
+    int32_t        o1, o2, w0, w1, w2, w3;
+    uint8_t      * p;
+    uint16_t     * e;
+
+    for (n = 0, p = pixels; n < max_pixel; n++, p += 4) {
+        pos = p[0] * (ICC_LUT_DIM - 1); ir = pos / 255; fr = pos - ir * 255;
+        pos = p[1] * (ICC_LUT_DIM - 1); ig = pos / 255; fg = pos - ig * 255;
+        pos = p[2] * (ICC_LUT_DIM - 1); ib = pos / 255; fb = pos - ib * 255;
+        if (ir == ICC_LUT_DIM - 1) { ir--; fr = 255; }
+        if (ig == ICC_LUT_DIM - 1) { ig--; fg = 255; }
+        if (ib == ICC_LUT_DIM - 1) { ib--; fb = 255; }
+        e = &t->lut[ir * s_r + ig * s_g + ib * s_b];
+
+        // select the tetrahedron containing the point; it has vertices 
+        // 0, o1, o1+o2, and the far corner; w0 - w3 are their weights
+        if (fr >= fg) {
+            if (fg >= fb) {
+                o1 = s_r; o2 = s_g; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+            } else if (fr >= fb) {
+                o1 = s_r; o2 = s_b; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+            } else {
+                o1 = s_b; o2 = s_r; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+            }
+        } else {
+            if (fr >= fb) {
+                o1 = s_g; o2 = s_r; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+            } else if (fg >= fb) {
+                o1 = s_g; o2 = s_b; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+            } else {
+                o1 = s_b; o2 = s_g; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+            }
+        }
+        w0 = 255 - w1 - w2 - w3;
+
+        for (c = 0; c < 3; c++) {
+            uint32_t v = w0 * e[c] + 
+                         w1 * e[o1+c] + 
+                         w2 * e[o1+o2+c] + 
+                         w3 * e[s_r+s_g+s_b+c];
+            // v is 0 - 255 * 65535, convert to 0 - 255
+            p[c] = (v + 255 * 257 / 2) / (255 * 257);
+        }
+    }
+}
+
+// same as icc_transform_apply, for 16 bit samples; the fractions within the 
+// lookup table cell are in units of 1/4096
+static void icc_transform_apply16(icc_transform_t * t, uint16_t * pixels, int64_t max_pixel)
+{
+    const int32_t  s_r = ICC_LUT_DIM * ICC_LUT_DIM * 3;
+    const int32_t  s_g = ICC_LUT_DIM * 3;
+    const int32_t  s_b = 3;
+    int64_t        n;
+    int32_t        c, ir, ig, ib, fr, fg, fb;
+    int32_t        o1, o2, w0, w1, w2, w3;
+    uint16_t     * p;
+    uint16_t     * e;
+
+    for (n = 0, p = pixels; n < max_pixel; n++, p += 4) {
+        // the position within the table, in units of 1/4096 of a cell
+        fr = ((int64_t)p[0] * (ICC_LUT_DIM - 1) * 4096 + 32767) / 65535; ir = fr >> 12; fr &= 4095;
+        fg = ((int64_t)p[1] * (ICC_LUT_DIM - 1) * 4096 + 32767) / 65535; ig = fg >> 12; fg &= 4095;
+        fb = ((int64_t)p[2] * (ICC_LUT_DIM - 1) * 4096 + 32767) / 65535; ib = fb >> 12; fb &= 4095;
+        if (ir == ICC_LUT_DIM - 1) { ir--; fr = 4096; }
+        if (ig == ICC_LUT_DIM - 1) { ig--; fg = 4096; }
+        if (ib == ICC_LUT_DIM - 1) { ib--; fb = 4096; }
+        e = &t->lut[ir * s_r + ig * s_g + ib * s_b];
+
+        if (fr >= fg) {
+            if (fg >= fb) {
+                o1 = s_r; o2 = s_g; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+            } else if (fr >= fb) {
+                o1 = s_r; o2 = s_b; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+            } else {
+                o1 = s_b; o2 = s_r; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+            }
+        } else {
+            if (fr >= fb) {
+                o1 = s_g; o2 = s_r; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+            } else if (fg >= fb) {
+                o1 = s_g; o2 = s_b; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+            } else {
+                o1 = s_b; o2 = s_g; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+            }
+        }
+        w0 = 4096 - w1 - w2 - w3;
+
+        for (c = 0; c < 3; c++) {
+            uint32_t v = w0 * e[c] + 
+                         w1 * e[o1+c] + 
+                         w2 * e[o1+o2+c] + 
+                         w3 * e[s_r+s_g+s_b+c];
+            p[c] = (v + 2048) >> 12;
+        }
+    }
+}
+
+// fnv-1a hash
+static uint64_t icc_hash(uint8_t * data, int32_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    int32_t  i;
+
+    for (i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -0,0 +1,44 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __UTIL_ICC_H__
+#define __UTIL_ICC_H__
+
+// select the output color profile, which the images are converted to by 
+// icc_convert; NULL selects sRGB, which is the default; returns -1, and 
+// selects sRGB, if the profile is not supported; just RGB matrix / TRC 
+// profiles are supported
+int32_t icc_set_output_profile(uint8_t * data, int32_t len);
+
+// convert the pixels, 4 bytes per pixel with red, green and blue first, from 
+// the input color profile to the output profile; icc_profile NULL is sRGB; 
+// an unsupported input profile is treated as sRGB; this can be called 
+// concurrently by multiple threads
+void icc_convert(uint8_t * icc_profile, int32_t icc_profile_len, uint8_t * pixels, int64_t max_pixel);
+
+// same as icc_convert, for pixels with 4 uint16 per pixel
+void icc_convert16(uint8_t * icc_profile, int32_t icc_profile_len, uint16_t * pixels, int64_t max_pixel);
+
+// read an icc profile file; the data is malloced
+int32_t icc_read_file(char * file_name, uint8_t ** data, int32_t * len);
+
+#endif
@@ -36,6 +36,7 @@ SOFTWARE.
 #include <jpeglib.h>
 
 #include "util_jpeg.h"
+#include "util_stats.h"
 #include "util_misc.h"
 
 //
@@ -51,20 +52,43 @@ SOFTWARE.
 
 #define BYTES_PER_PIXEL 4
 
+// the number of scanlines that are read together, so that for the orientations
+// that transpose the image the output is written in runs of this many pixels
+#define SCANLINE_BAND 32
+
+// the icc profile is stored in APP2 markers, which begin with this 12 byte 
+// identifier followed by the 1 based sequence number and the number of markers
+#define ICC_MARKER          (JPEG_APP0 + 2)
+#define ICC_ID              "ICC_PROFILE"
+#define ICC_ID_LEN          12
+#define ICC_HDR_LEN         (ICC_ID_LEN + 2)
+#define MAX_ICC_MARKER_DATA (65533 - ICC_HDR_LEN)
+
 //
 // typedefs
 //
 
+// the jpeg error manager is extended with a jmpbuf, so that the 
+// error exit override can longjmp back to the caller; each call has 
+// its own jmpbuf, so that files can be read and written concurrently
+// by multiple threads
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf               jmpbuf;
+} jpeg_err_mgr_t;
+
 //
 // variables
 //
 
-static jmp_buf err_jmpbuf;
-
 //
 // prototypes
 //
 
+static int32_t read_jpeg(char* file_name, int32_t max_image_dim, bool preview, int32_t orientation,
+                         uint8_t ** pixels, int32_t * width, int32_t * height,
+                         uint8_t ** icc_profile, int32_t * icc_profile_len);
+static uint8_t * read_icc_profile(j_decompress_ptr cinfo, int32_t * icc_profile_len);
 static void jpeg_decode_error_exit_override(j_common_ptr cinfo);
 static void jpeg_decode_output_message_override(j_common_ptr cinfo);
 
@@ -80,23 +104,75 @@ static void jpeg_decode_output_message_override(j_common_ptr cinfo);
 //   For extremely large jpeg images or extremely small max_image_dim, the
 //   scaling will reduce the image by a factor of 8, which may not succeed in 
 //   reducing the returned image's dimensions to less or equal to the max_image_dim.
+// - orientation: the exif orientation, 1 - 8; the returned image is rotated and 
+//   flipped, as it is decoded, so that it is displayed upright; values outside 
+//   of 1 - 8 are the same as 1, which is no change
 // - pixels: the pixels is malloced by read_jpeg_file; the caller should free
 //   this memory when done; 4 bytes per pixel; in SDL_PIXELFORMAT_ABGR8888
 // - width, height: return the image width and height
+// - icc_profile, icc_profile_len: return the embedded icc profile, malloced, 
+//   or NULL if the file has none; the caller should free this memory; when 
+//   icc_profile is NULL the profile is not returned
+//
+// Notes:
+// - read_jpeg_file and read_jpeg_file_preview can be called concurrently by multiple threads
 //
 
-int32_t read_jpeg_file(char* file_name, int32_t max_image_dim,
-                       uint8_t ** pixels, int32_t * width, int32_t * height)
+int32_t read_jpeg_file(char* file_name, int32_t max_image_dim, int32_t orientation,
+                       uint8_t ** pixels, int32_t * width, int32_t * height,
+                       uint8_t ** icc_profile, int32_t * icc_profile_len)
+{
+    return read_jpeg(file_name, max_image_dim, false, orientation, pixels, width, height,
+                     icc_profile, icc_profile_len);
+}
+
+//
+// Reads a low quality preview of the jpeg file, quickly. The image is 
+// scaled by 1/8 in the DCT domain, so just the DC coefficient of each block is used, 
+// and the fast integer DCT is used without fancy upsampling.
+//
+// Args: same as read_jpeg_file
+//
+
+int32_t read_jpeg_file_preview(char* file_name, int32_t orientation,
+                               uint8_t ** pixels, int32_t * width, int32_t * height,
+                               uint8_t ** icc_profile, int32_t * icc_profile_len)
+{
+    return read_jpeg(file_name, 0, true, orientation, pixels, width, height,
+                     icc_profile, icc_profile_len);
+}
+
+//
+// The exif orientation is applied as the scanlines are expanded from RGB to 
+// RGBA, rather than by a separate pass over the image. Source pixel (x,y) is 
+// stored at out[base + x * step_x + y * step_y], in pixels. For orientations 
+// 1 - 4 step_x is +/-1, so each scanline is written contiguously. For 5 - 8 the 
+// image is transposed, step_y is +/-1, and SCANLINE_BAND scanlines are read 
+// together so that each column of the band is written as a contiguous run.
+//
+
+static int32_t read_jpeg(char* file_name, int32_t max_image_dim, bool preview, int32_t orientation,
+                         uint8_t ** pixels, int32_t * width, int32_t * height,
+                         uint8_t ** icc_profile, int32_t * icc_profile_len)
 {
     FILE                          * fp = NULL;
     struct jpeg_decompress_struct   cinfo; 
-    struct jpeg_error_mgr           err_mgr;
-    uint8_t                       * out = NULL;
+    jpeg_err_mgr_t                  err_mgr;
+    uint8_t              * volatile out = NULL;
+    JSAMPLE              * volatile band = NULL;
+    uint8_t              * volatile icc = NULL;
+    int32_t                volatile icc_len = 0;
+    int64_t                         w, h, base, step_x, step_y;
+    bool                            transpose;
 
     // preset returns to caller
     *pixels = NULL;
     *width  = 0;
     *height = 0;
+    if (icc_profile) {
+        *icc_profile = NULL;
+        *icc_profile_len = 0;
+    }
 
     // open file_name
     fp = fopen(file_name, "rb");
@@ -105,25 +181,36 @@ int32_t read_jpeg_file(char* file_name, int32_t max_image_dim,
         return -1;
     }
 
-    // initailze setjmp, for use by the error exit override
-    if (setjmp(err_jmpbuf)) {
-        goto error_return;
-    }
-
     // error management init:
     // - override the error_exit routine
     // - override the output_message routine
-    cinfo.err = jpeg_std_error(&err_mgr);
+    cinfo.err = jpeg_std_error(&err_mgr.pub);
     cinfo.err->error_exit = jpeg_decode_error_exit_override;
     cinfo.err->output_message = jpeg_decode_output_message_override;
 
+    // initailze setjmp, for use by the error exit override
+    if (setjmp(err_mgr.jmpbuf)) {
+        goto error_return;
+    }
+
     // initialize the jpeg decompress object,
     // supply fp to the jpeg decoder,
+    // save the APP2 markers if the icc profile is requested,
     // read the jpeg header, require_image==true
     jpeg_create_decompress(&cinfo);
     jpeg_stdio_src(&cinfo, fp);
+    if (icc_profile) {
+        jpeg_save_markers(&cinfo, ICC_MARKER, 0xffff);
+    }
     jpeg_read_header(&cinfo, true);
 
+    // assemble the icc profile from the saved markers
+    if (icc_profile) {
+        int32_t len;
+        icc = read_icc_profile(&cinfo, &len);
+        icc_len = len;
+    }
+
     // set the desired output pixel format
     cinfo.out_color_space = JCS_RGB;
 
@@ -144,36 +231,84 @@ int32_t read_jpeg_file(char* file_name, int32_t max_image_dim,
         }
     }
 
+    // if a preview is requested then use the fastest decode options
+    if (preview) {
+        cinfo.scale_denom = 8;
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = false;
+        cinfo.do_block_smoothing = false;
+    }
+
     // initialize the decompression, this sets cinfo.output_width and cinfo.output_height
     jpeg_start_decompress(&cinfo);
 
-    // allocate memory for the output, must be after call to jpeg_start_decompress
-    out = malloc(cinfo.output_width * cinfo.output_height * BYTES_PER_PIXEL);
-    if (out == NULL) {
+    // allocate memory for the output, and for a band of scanlines;
+    // this must be after call to jpeg_start_decompress
+    out = malloc((size_t)cinfo.output_width * cinfo.output_height * BYTES_PER_PIXEL);
+    band = malloc((size_t)cinfo.output_width * 3 * SCANLINE_BAND);
+    if (out == NULL || band == NULL) {
         ERROR("failed allocate memory for width=%d height=%d bytes_per_pixel=%d\n",
                cinfo.output_width, cinfo.output_height, BYTES_PER_PIXEL);
         goto error_return;
     }
 
-    // loop over scanlines
-    uint8_t * outp = out;
+    // determine where the source pixels are stored in the output, for the orientation
+    w = cinfo.output_width;
+    h = cinfo.output_height;
+    transpose = (orientation >= 5 && orientation <= 8);
+    switch (orientation) {
+    case 2:  base = w-1;       step_x = -1; step_y = w;  break;  // flip horizontal
+    case 3:  base = w*h-1;     step_x = -1; step_y = -w; break;  // rotate 180
+    case 4:  base = (h-1)*w;   step_x = 1;  step_y = -w; break;  // flip vertical
+    case 5:  base = 0;         step_x = h;  step_y = 1;  break;  // transpose
+    case 6:  base = h-1;       step_x = h;  step_y = -1; break;  // rotate 90 clockwise
+    case 7:  base = w*h-1;     step_x = -h; step_y = -1; break;  // transverse
+    case 8:  base = (w-1)*h;   step_x = -h; step_y = 1;  break;  // rotate 90 counter clockwise
+    default: base = 0;         step_x = 1;  step_y = w;  break;  // normal
+    }
+
+    // loop over bands of scanlines
     while (cinfo.output_scanline < cinfo.output_height) {
-        int32_t i;
-        JSAMPLE   row[1000000];
-        JSAMPROW  scanline[1] = { row };
-        uint8_t * r = row;
+        JSAMPROW  scanline[SCANLINE_BAND];
+        int64_t   y0 = cinfo.output_scanline;
+        int32_t   i, j, n = 0;
+
+        // read the band
+        for (i = 0; i < SCANLINE_BAND; i++) {
+            scanline[i] = band + (size_t)i * w * 3;
+        }
+        while (n < SCANLINE_BAND && cinfo.output_scanline < cinfo.output_height) {
+            n += jpeg_read_scanlines(&cinfo, &scanline[n], SCANLINE_BAND - n);
+        }
 
-        // read one scanline
-        jpeg_read_scanlines(&cinfo, scanline, 1);
-
-        // save the row data in the output buffer
-        for (i = 0; i < cinfo.output_width; i++) {
-            outp[0] = r[0];
-            outp[1] = r[1];
-            outp[2] = r[2];
-            outp[3] = 255;  
-            outp+=4;
-            r+=3;
+        // save the band in the output buffer
+        if (!transpose) {
+            for (j = 0; j < n; j++) {
+                uint8_t * r = scanline[j];
+                uint8_t * outp = out + (base + (y0 + j) * step_y) * BYTES_PER_PIXEL;
+                int32_t   step = step_x * BYTES_PER_PIXEL;
+                for (i = 0; i < w; i++) {
+                    outp[0] = r[0];
+                    outp[1] = r[1];
+                    outp[2] = r[2];
+                    outp[3] = 255;  
+                    outp += step;
+                    r += 3;
+                }
+            }
+        } else {
+            for (i = 0; i < w; i++) {
+                uint8_t * outp = out + (base + i * step_x + y0 * step_y) * BYTES_PER_PIXEL;
+                int32_t   step = step_y * BYTES_PER_PIXEL;
+                for (j = 0; j < n; j++) {
+                    uint8_t * r = scanline[j] + i * 3;
+                    outp[0] = r[0];
+                    outp[1] = r[1];
+                    outp[2] = r[2];
+                    outp[3] = 255;  
+                    outp += step;
+                }
+            }
         }
     }
 
@@ -183,9 +318,14 @@ int32_t read_jpeg_file(char* file_name, int32_t max_image_dim,
     // success return
     jpeg_destroy_decompress(&cinfo);
     fclose(fp);
+    free(band);
     *pixels = out;
-    *width  = cinfo.output_width;
-    *height = cinfo.output_height;
+    *width  = (transpose ? h : w);
+    *height = (transpose ? w : h);
+    if (icc_profile) {
+        *icc_profile = icc;
+        *icc_profile_len = icc_len;
+    }
     return 0;
 
     // error return
@@ -193,17 +333,86 @@ error_return:
     jpeg_destroy_decompress(&cinfo);
     fclose(fp);
     free(out);
+    free(band);
+    free(icc);
     return -1;
 }
 
+// The icc profile may be split across multiple APP2 markers. Each marker's 
+// data has the ICC_ID, the sequence number, 1 to count, and the count. 
+// Returns NULL if there is no profile or the markers are not valid.
+static uint8_t * read_icc_profile(j_decompress_ptr cinfo, int32_t * icc_profile_len)
+{
+    jpeg_saved_marker_ptr  m;
+    jpeg_saved_marker_ptr  seq_marker[256];
+    int32_t                count = 0, seq, len = 0, off;
+    uint8_t              * icc;
+
+    *icc_profile_len = 0;
+    memset(seq_marker, 0, sizeof(seq_marker));
+
+    // find the marker for each sequence number
+    for (m = cinfo->marker_list; m != NULL; m = m->next) {
+        if (m->marker != ICC_MARKER || m->data_length <= ICC_HDR_LEN ||
+            memcmp(m->data, ICC_ID, ICC_ID_LEN) != 0)
+        {
+            continue;
+        }
+        seq = m->data[ICC_ID_LEN];
+        if (count == 0) {
+            count = m->data[ICC_ID_LEN+1];
+        }
+        if (seq == 0 || seq > count || m->data[ICC_ID_LEN+1] != count || seq_marker[seq] != NULL) {
+            WARN("invalid icc profile marker, seq=%d count=%d\n", seq, m->data[ICC_ID_LEN+1]);
+            return NULL;
+        }
+        seq_marker[seq] = m;
+        len += m->data_length - ICC_HDR_LEN;
+    }
+    if (count == 0) {
+        return NULL;
+    }
+    for (seq = 1; seq <= count; seq++) {
+        if (seq_marker[seq] == NULL) {
+            WARN("icc profile marker %d of %d is missing\n", seq, count);
+            return NULL;
+        }
+    }
+
+    // concatenate the marker data, in sequence order
+    icc = malloc(len);
+    if (icc == NULL) {
+        ERROR("failed allocate memory for icc profile, len=%d\n", len);
+        return NULL;
+    }
+    for (seq = 1, off = 0; seq <= count; seq++) {
+        m = seq_marker[seq];
+        memcpy(icc + off, m->data + ICC_HDR_LEN, m->data_length - ICC_HDR_LEN);
+        off += m->data_length - ICC_HDR_LEN;
+    }
+
+    *icc_profile_len = len;
+    return icc;
+}
+
 // -----------------  JPEG COMPRESSION  ----------------------------------------------------
 
+//
+// Args:
+// - pixels: 4 bytes per pixel, in SDL_PIXELFORMAT_ABGR8888
+// - icc_profile, icc_profile_len: when icc_profile is not NULL it is embedded 
+//   in the file, in APP2 markers
+//
+
 int32_t write_jpeg_file(char* file_name, 
-                       uint8_t * pixels, int32_t width, int32_t height)
+                       uint8_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len)
 {
     FILE                        * fp = NULL;
     struct jpeg_compress_struct   cinfo; 
-    struct jpeg_error_mgr         err_mgr;
+    jpeg_err_mgr_t                err_mgr;
+    JSAMPLE            * volatile row = NULL;
+    uint64_t                      start;
 
     // open file_name
     fp = fopen(file_name, "wb");
@@ -212,18 +421,19 @@ int32_t write_jpeg_file(char* file_name,
         return -1;
     }
 
-    // initailze setjmp, for use by the error exit override
-    if (setjmp(err_jmpbuf)) {
-        goto error_return;
-    }
-
     // error management init:
     // - override the error_exit routine
     // - override the output_message routine
-    cinfo.err = jpeg_std_error(&err_mgr);
+    cinfo.err = jpeg_std_error(&err_mgr.pub);
     cinfo.err->error_exit = jpeg_decode_error_exit_override;
     cinfo.err->output_message = jpeg_decode_output_message_override;
 
+    // initailze setjmp, for use by the error exit override
+    if (setjmp(err_mgr.jmpbuf)) {
+        goto error_return;
+    }
+    start = STATS_SPAN_BEGIN();
+
     // initialize the jpeg compress object,
     // supply fp to the jpeg encoder,
     jpeg_create_compress(&cinfo);
@@ -241,11 +451,43 @@ int32_t write_jpeg_file(char* file_name,
     // initialize the compression
     jpeg_start_compress(&cinfo, TRUE);
 
+    // write the icc profile markers, these must follow jpeg_start_compress
+    if (icc_profile) {
+        int32_t count = (icc_profile_len + MAX_ICC_MARKER_DATA - 1) / MAX_ICC_MARKER_DATA;
+        int32_t seq, off, len, i;
+
+        if (count > 255) {
+            ERROR("icc profile too large, len=%d\n", icc_profile_len);
+            goto error_return;
+        }
+        for (seq = 1, off = 0; seq <= count; seq++, off += len) {
+            len = icc_profile_len - off;
+            if (len > MAX_ICC_MARKER_DATA) {
+                len = MAX_ICC_MARKER_DATA;
+            }
+            jpeg_write_m_header(&cinfo, ICC_MARKER, ICC_HDR_LEN + len);
+            for (i = 0; i < ICC_ID_LEN; i++) {
+                jpeg_write_m_byte(&cinfo, ICC_ID[i]);   // includes the terminating 0
+            }
+            jpeg_write_m_byte(&cinfo, seq);
+            jpeg_write_m_byte(&cinfo, count);
+            for (i = 0; i < len; i++) {
+                jpeg_write_m_byte(&cinfo, icc_profile[off+i]);
+            }
+        }
+    }
+
+    // allocate memory for a scanline
+    row = malloc(width * 3);
+    if (row == NULL) {
+        ERROR("failed allocate memory for width=%d\n", width);
+        goto error_return;
+    }
+
     // loop over scanlines
     uint8_t * inp = pixels;
     while (cinfo.next_scanline < cinfo.image_height) {
         int32_t   i;
-        JSAMPLE   row[1000000];
         JSAMPROW  scanline[1] = { row };
         uint8_t * r = row;
 
@@ -265,16 +507,19 @@ int32_t write_jpeg_file(char* file_name,
 
     // finish compress
     jpeg_finish_compress(&cinfo);
+    STATS_SPAN_END(STATS_STAGE_ENCODE, -1, start);
 
     // success return
     jpeg_destroy_compress(&cinfo);
     fclose(fp);
+    free(row);
     return 0;
 
     // error return
 error_return:
     jpeg_destroy_compress(&cinfo);
     fclose(fp);
+    free(row);
     return -1;
 }
 
@@ -282,8 +527,10 @@ error_return:
 
 static void jpeg_decode_error_exit_override(j_common_ptr cinfo)
 {
+    jpeg_err_mgr_t * err_mgr = (jpeg_err_mgr_t *)cinfo->err;
+
     (*cinfo->err->output_message)(cinfo);
-    longjmp(err_jmpbuf, 1);
+    longjmp(err_mgr->jmpbuf, 1);
 }
 
 static void jpeg_decode_output_message_override(j_common_ptr cinfo)
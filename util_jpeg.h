@@ -23,10 +23,15 @@ SOFTWARE.
 #ifndef __UTIL_JPEG_H__
 #define __UTIL_JPEG_H__
 
-int32_t read_jpeg_file(char* file_name, int32_t max_image_dim,
-                       uint8_t ** pixels, int32_t * width, int32_t * height);
+int32_t read_jpeg_file(char* file_name, int32_t max_image_dim, int32_t orientation,
+                       uint8_t ** pixels, int32_t * width, int32_t * height,
+                       uint8_t ** icc_profile, int32_t * icc_profile_len);
+int32_t read_jpeg_file_preview(char* file_name, int32_t orientation,
+                       uint8_t ** pixels, int32_t * width, int32_t * height,
+                       uint8_t ** icc_profile, int32_t * icc_profile_len);
 
 int32_t write_jpeg_file(char* file_name,
-                       uint8_t * pixels, int32_t width, int32_t height);
+                       uint8_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len);
 
 #endif
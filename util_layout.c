@@ -0,0 +1,486 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "util_sdl.h"
+#include "util_layout.h"
+#include "util_misc.h"
+
+//
+// defines
+//
+
+#define MOSAIC_SCALE_SEARCH_ITER 20
+
+//
+// typedefs
+//
+
+typedef struct {
+    double  * prefix;      // prefix[i] is the sum of the weights of items 0 .. i-1
+    double    avg;         // the average part weight
+    double  * prev_cost;   // min cost of the first i items in j-1 parts
+    double  * cost;        // min cost of the first i items in j parts
+    int32_t * opt;         // start of part j in the min cost solution for the first i items
+    int32_t * opt_prev;    // start of part j-1 in the min cost solution, in j-1 parts
+} partition_t;
+
+typedef struct {
+    int32_t x;
+    int32_t y;             // the bottom of the images already packed in x .. x+w-1
+    int32_t w;
+} skyline_seg_t;
+
+typedef struct {
+    double  aspect;
+    int32_t idx;
+} mosaic_item_t;
+
+//
+// variables
+//
+
+//
+// prototypes
+//
+
+static void partition_solve(partition_t * pt, int32_t i_lo, int32_t i_hi, int32_t p_lo, int32_t p_hi);
+static int32_t mosaic_pack(mosaic_item_t * item, int32_t max_item, double area, 
+                           int32_t width, int32_t height, skyline_seg_t * seg, rect_t * rect,
+                           bool partial);
+static int mosaic_item_compare(const void * a, const void * b);
+
+// -----------------  LINEAR PARTITION  ----------------------------------------
+
+// The linear partition is solved with a dynamic program, in which the cost of 
+// a part is the square of the difference between its weight and the average
+// part weight:
+//     cost[j][i] = min over p of  cost[j-1][p] + (weight of items p..i-1 - avg)^2
+// The p that minimizes cost[j][i] does not decrease as i increases, so each 
+// row j is solved by divide and conquer: the optimal p of the middle i is found,
+// and this bounds the search for the i on either side. The optimal p also does not
+// decrease as j increases, so it is bounded below by the optimal p of row j-1.
+// This is at most O(max_part * max_item * log(max_item)), rather than the 
+// O(max_part * max_item^2) of the direct solution.
+
+int32_t layout_linear_partition(double * weight, int32_t max_item, int32_t max_part, 
+                                int32_t * part_start)
+{
+    partition_t pt;
+    double    * tmp;
+    int32_t     i, j, end, ret;
+
+    if (max_part < 1 || max_part > max_item) {
+        ERROR("invalid max_part=%d max_item=%d\n", max_part, max_item);
+        return -1;
+    }
+
+    // allocate 
+    pt.prefix    = malloc((max_item+1) * sizeof(double));
+    pt.prev_cost = malloc((max_item+1) * sizeof(double));
+    pt.cost      = malloc((max_item+1) * sizeof(double));
+    pt.opt       = malloc((size_t)max_part * (max_item+1) * sizeof(int32_t));
+    if (!pt.prefix || !pt.prev_cost || !pt.cost || !pt.opt) {
+        ERROR("allocate failed, max_item=%d max_part=%d\n", max_item, max_part);
+        goto error;
+    }
+
+    // init
+    pt.prefix[0] = 0;
+    for (i = 0; i < max_item; i++) {
+        pt.prefix[i+1] = pt.prefix[i] + weight[i];
+    }
+    pt.avg = pt.prefix[max_item] / max_part;
+
+    // solve for 1 part
+    pt.opt_prev = NULL;
+    for (i = 0; i <= max_item; i++) {
+        double d = pt.prefix[i] - pt.avg;
+        pt.cost[i] = (i >= 1 ? d * d : HUGE_VAL);
+        pt.opt[i] = 0;
+    }
+
+    // solve for 2 .. max_part parts; the j+1 parts of the first i items
+    // require i >= j+1
+    for (j = 1; j < max_part; j++) {
+        tmp = pt.prev_cost;
+        pt.prev_cost = pt.cost;
+        pt.cost = tmp;
+        for (i = 0; i <= j; i++) {
+            pt.cost[i] = HUGE_VAL;
+        }
+        pt.opt_prev = pt.opt;
+        pt.opt += max_item+1;
+        partition_solve(&pt, j+1, max_item, j, max_item-1);
+    }
+    pt.opt -= (size_t)(max_part-1) * (max_item+1);
+
+    // determine part_start, by tracing back the optimal solution
+    part_start[max_part] = max_item;
+    end = max_item;
+    for (j = max_part-1; j >= 0; j--) {
+        end = pt.opt[(size_t)j * (max_item+1) + end];
+        part_start[j] = end;
+    }
+
+    // success
+    ret = 0;
+    goto cleanup;
+
+error:
+    ret = -1;
+    goto cleanup;
+
+cleanup:
+    free(pt.prefix);
+    free(pt.prev_cost);
+    free(pt.cost);
+    free(pt.opt);
+    return ret;
+}
+
+// solve cost[i] and opt[i] for i_lo .. i_hi, given that opt[i] is in the range p_lo .. p_hi
+static void partition_solve(partition_t * pt, int32_t i_lo, int32_t i_hi, int32_t p_lo, int32_t p_hi)
+{
+    int32_t i, p, p_min, p_max, best_p;
+    double  best, c, d;
+
+    if (i_lo > i_hi) {
+        return;
+    }
+
+    i = (i_lo + i_hi) / 2;
+    p_min = p_lo;
+    if (pt->opt_prev != NULL && pt->opt_prev[i] > p_min) {
+        p_min = pt->opt_prev[i];
+    }
+    p_max = (p_hi < i-1 ? p_hi : i-1);
+    best = HUGE_VAL;
+    best_p = p_max;
+    for (p = p_max; p >= p_min; p--) {
+        d = pt->prefix[i] - pt->prefix[p] - pt->avg;
+        c = pt->prev_cost[p] + d * d;
+        if (c < best) {
+            best = c;
+            best_p = p;
+        }
+        // the weight of the last part increases as p decreases, so once it 
+        // exceeds the average by enough that its cost alone is more than best 
+        // no smaller p can be better
+        if (d > 0 && d * d >= best) {
+            break;
+        }
+    }
+    pt->cost[i] = best;
+    pt->opt[i] = best_p;
+
+    partition_solve(pt, i_lo, i-1, p_lo, best_p);
+    partition_solve(pt, i+1, i_hi, best_p, p_hi);
+}
+
+// -----------------  JUSTIFIED ROWS  ------------------------------------------
+
+int32_t layout_justified_rows(double * aspect, int32_t max_image, int32_t rows,
+                              int32_t width, int32_t height,
+                              rect_t * rect, int32_t * width_used, int32_t * height_used)
+{
+    int32_t * row_start;
+    double    row_aspect, total_height, scale, cum_height, cum_aspect;
+    int32_t   r, i, x, y, y_next, row_width;
+
+    // preset returns
+    *width_used = 0;
+    *height_used = 0;
+
+    // partition the images into rows; the weight of each image is its aspect ratio,
+    // which is the image width when the image height is 1
+    if (rows > max_image) {
+        rows = max_image;
+    }
+    if (rows < 1) {
+        return -1;
+    }
+    row_start = malloc((rows+1) * sizeof(int32_t));
+    if (row_start == NULL) {
+        ERROR("allocate row_start failed, rows=%d\n", rows);
+        return -1;
+    }
+    if (layout_linear_partition(aspect, max_image, rows, row_start) != 0) {
+        free(row_start);
+        return -1;
+    }
+
+    // determine the total height of the rows, when each row is width wide;
+    // and the scale factor needed for the rows to also fit within height
+    total_height = 0;
+    for (r = 0; r < rows; r++) {
+        row_aspect = 0;
+        for (i = row_start[r]; i < row_start[r+1]; i++) {
+            row_aspect += aspect[i];
+        }
+        total_height += width / row_aspect;
+    }
+    scale = (total_height > height ? height / total_height : 1);
+    row_width = nearbyint(width * scale);
+
+    // determine the rect of each image; the row y and image x locations are 
+    // rounded from their cumulative values, so that there are no gaps
+    y = 0;
+    cum_height = 0;
+    for (r = 0; r < rows; r++) {
+        row_aspect = 0;
+        for (i = row_start[r]; i < row_start[r+1]; i++) {
+            row_aspect += aspect[i];
+        }
+        cum_height += width * scale / row_aspect;
+        y_next = nearbyint(cum_height);
+
+        x = 0;
+        cum_aspect = 0;
+        for (i = row_start[r]; i < row_start[r+1]; i++) {
+            cum_aspect += aspect[i];
+            rect[i].x = x;
+            rect[i].y = y;
+            rect[i].w = (int32_t)nearbyint(row_width * cum_aspect / row_aspect) - x;
+            rect[i].h = y_next - y;
+            x += rect[i].w;
+        }
+        y = y_next;
+    }
+
+    *width_used = row_width;
+    *height_used = y;
+    free(row_start);
+    return 0;
+}
+
+// -----------------  MOSAIC  --------------------------------------------------
+
+// The images are given the same area, and a binary search finds the largest area
+// for which all of the images can be packed in width by height. 
+//
+// The packing uses a skyline packer: the bottom edge of the images already packed
+// is kept as a list of horizontal segments, and each image is placed at the 
+// location where its bottom edge is highest, and then leftmost. The images are
+// packed tallest first. The cost of packing is O(max_image * number of segments),
+// the number of segments is roughly the number of images that fit in a row; 
+// whereas a maxrects or guillotine packer tracks free rectangles, whose number
+// grows with max_image, and so is O(max_image^2).
+//
+// When there are more images than can be packed at the minimum size of 1x1, 
+// such as many thousands of images in a small window, the images that do 
+// not fit are given empty panes.
+
+int32_t layout_mosaic(double * aspect, int32_t max_image, int32_t width, int32_t height,
+                      rect_t * rect, int32_t * width_used, int32_t * height_used, 
+                      double * fill_ratio)
+{
+    mosaic_item_t * item;
+    skyline_seg_t * seg;
+    double          area_lo, area_hi, area, image_area;
+    int32_t         i, iter, ret;
+
+    // preset returns
+    *width_used = 0;
+    *height_used = 0;
+    *fill_ratio = 0;
+
+    if (max_image < 1 || width < 1 || height < 1) {
+        return -1;
+    }
+
+    // allocate; the packer adds at most one segment per image
+    item = malloc(max_image * sizeof(mosaic_item_t));
+    seg  = malloc((max_image + 1) * sizeof(skyline_seg_t));
+    if (item == NULL || seg == NULL) {
+        ERROR("allocate failed, max_image=%d\n", max_image);
+        goto error;
+    }
+
+    // sort the images tallest first; the image height for a given area 
+    // is sqrt(area / aspect), so this is the order of increasing aspect
+    for (i = 0; i < max_image; i++) {
+        item[i].aspect = aspect[i];
+        item[i].idx = i;
+    }
+    qsort(item, max_image, sizeof(mosaic_item_t), mosaic_item_compare);
+
+    // binary search for the largest image area that can be packed; this can
+    // not exceed the area of width by height divided by max_image
+    area_lo = 0;
+    area_hi = (double)width * height / max_image;
+    for (iter = 0; iter < MOSAIC_SCALE_SEARCH_ITER; iter++) {
+        area = (area_lo + area_hi) / 2;
+        if (mosaic_pack(item, max_image, area, width, height, seg, rect, false) == 0) {
+            area_lo = area;
+        } else {
+            area_hi = area;
+        }
+    }
+    mosaic_pack(item, max_image, area_lo, width, height, seg, rect, true);
+
+    // determine the bounding box of the packed images, and the fill ratio
+    image_area = 0;
+    for (i = 0; i < max_image; i++) {
+        if (rect[i].x + rect[i].w > *width_used) {
+            *width_used = rect[i].x + rect[i].w;
+        }
+        if (rect[i].y + rect[i].h > *height_used) {
+            *height_used = rect[i].y + rect[i].h;
+        }
+        image_area += (double)rect[i].w * rect[i].h;
+    }
+    if (*width_used > 0 && *height_used > 0) {
+        *fill_ratio = image_area / ((double)*width_used * *height_used);
+    }
+
+    // success
+    ret = 0;
+    goto cleanup;
+
+error:
+    ret = -1;
+    goto cleanup;
+
+cleanup:
+    free(item);
+    free(seg);
+    return ret;
+}
+
+// pack the images, each with the specified area, using the skyline packer; 
+// returns -1 if the images do not all fit in width by height; except when 
+// partial is set, then the images that do not fit are given empty rects
+static int32_t mosaic_pack(mosaic_item_t * item, int32_t max_item, double area, 
+                           int32_t width, int32_t height, skyline_seg_t * seg, rect_t * rect,
+                           bool partial)
+{
+    int32_t i, j, k, w, h, x, y, span, end, max_seg;
+    int32_t best_j, best_y, best_bottom;
+
+    // the skyline starts as a single segment, the top edge of the area
+    seg[0].x = 0;
+    seg[0].y = 0;
+    seg[0].w = width;
+    max_seg = 1;
+
+    for (i = 0; i < max_item; i++) {
+        // determine the image size
+        w = sqrt(area * item[i].aspect);
+        h = sqrt(area / item[i].aspect);
+        if (w < 1) w = 1;
+        if (h < 1) h = 1;
+        if (w > width || h > height) {
+            if (!partial) {
+                return -1;
+            }
+            memset(&rect[item[i].idx], 0, sizeof(rect_t));
+            continue;
+        }
+
+        // find the location, at the start of a segment, where the bottom of 
+        // the image would be highest; the image is placed on the highest of the 
+        // segments that it spans
+        best_j = -1;
+        best_y = 0;
+        best_bottom = INT_MAX;
+        for (j = 0; j < max_seg && seg[j].x + w <= width; j++) {
+            y = 0;
+            span = 0;
+            for (k = j; span < w; k++) {
+                if (seg[k].y > y) {
+                    y = seg[k].y;
+                }
+                span += seg[k].w;
+            }
+            if (y + h < best_bottom) {
+                best_bottom = y + h;
+                best_y = y;
+                best_j = j;
+            }
+        }
+        if (best_j == -1 || best_bottom > height) {
+            if (!partial) {
+                return -1;
+            }
+            memset(&rect[item[i].idx], 0, sizeof(rect_t));
+            continue;
+        }
+
+        // place the image
+        x = seg[best_j].x;
+        rect[item[i].idx].x = x;
+        rect[item[i].idx].y = best_y;
+        rect[item[i].idx].w = w;
+        rect[item[i].idx].h = h;
+
+        // update the skyline: the segments spanned by the image are replaced 
+        // by a new segment at the bottom of the image; the last segment spanned
+        // is trimmed if it extends beyond the image
+        end = x + w;
+        for (k = best_j; k < max_seg && seg[k].x + seg[k].w <= end; k++) {
+            ;
+        }
+        if (k < max_seg && seg[k].x < end) {
+            seg[k].w -= end - seg[k].x;
+            seg[k].x = end;
+        }
+        memmove(&seg[best_j+1], &seg[k], (max_seg - k) * sizeof(skyline_seg_t));
+        max_seg = best_j + 1 + (max_seg - k);
+        seg[best_j].x = x;
+        seg[best_j].y = best_y + h;
+        seg[best_j].w = w;
+
+        // merge the new segment with its neighbors, if they are at the same y
+        if (best_j + 1 < max_seg && seg[best_j+1].y == seg[best_j].y) {
+            seg[best_j].w += seg[best_j+1].w;
+            memmove(&seg[best_j+1], &seg[best_j+2], (max_seg - best_j - 2) * sizeof(skyline_seg_t));
+            max_seg--;
+        }
+        if (best_j > 0 && seg[best_j-1].y == seg[best_j].y) {
+            seg[best_j-1].w += seg[best_j].w;
+            memmove(&seg[best_j], &seg[best_j+1], (max_seg - best_j - 1) * sizeof(skyline_seg_t));
+            max_seg--;
+        }
+    }
+
+    return 0;
+}
+
+static int mosaic_item_compare(const void * a, const void * b)
+{
+    const mosaic_item_t * x = a;
+    const mosaic_item_t * y = b;
+
+    if (x->aspect != y->aspect) {
+        return x->aspect < y->aspect ? -1 : 1;
+    }
+    return x->idx - y->idx;
+}
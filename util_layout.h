@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef __UTIL_LAYOUT_H__
+#define __UTIL_LAYOUT_H__
+
+// -----------------  LINEAR PARTITION  --------------------------
+
+// partition the max_item items, in order, into max_part contiguous parts 
+// whose weight sums are as equal as possible; part_start must have 
+// max_part+1 entries, part_start[j] is set to the first item of part j, and
+// part_start[max_part] is set to max_item; 1 <= max_part <= max_item
+int32_t layout_linear_partition(double * weight, int32_t max_item, int32_t max_part, 
+                                int32_t * part_start);
+
+// -----------------  JUSTIFIED ROWS  ----------------------------
+
+// arrange the images, in order, in rows; each image is displayed at its
+// aspect ratio (width / height), and all images of a row have the same height;
+// the images are partitioned into rows so that the rows, when scaled to the same
+// width, have heights that are as equal as possible; the layout is then scaled to
+// fit in width by height, and width_used or height_used may be less than these
+int32_t layout_justified_rows(double * aspect, int32_t max_image, int32_t rows,
+                              int32_t width, int32_t height,
+                              rect_t * rect, int32_t * width_used, int32_t * height_used);
+
+// -----------------  MOSAIC  ------------------------------------
+
+// pack the images, each displayed at its aspect ratio and all with the same area, 
+// into width by height; the largest image area that can be packed is found;
+// width_used and height_used are the bounding box of the packed images, and 
+// fill_ratio is the fraction of the bounding box that is covered by the images;
+// the images that do not fit, even at 1x1, are given empty rects
+int32_t layout_mosaic(double * aspect, int32_t max_image, int32_t width, int32_t height,
+                      rect_t * rect, int32_t * width_used, int32_t * height_used, 
+                      double * fill_ratio);
+
+#endif
@@ -43,15 +43,31 @@ SOFTWARE.
 void logmsg(char *lvl, const char *func, char *fmt, ...) 
 {
     va_list ap;
-    char    msg[1000];
+    char    msg_buff[1000];
+    char  * msg = msg_buff;
     int     len;
     char    time_str[MAX_TIME_STR];
 
     // construct msg
     va_start(ap, fmt);
-    vsnprintf(msg, sizeof(msg), fmt, ap);
+    len = vsnprintf(msg_buff, sizeof(msg_buff), fmt, ap);
     va_end(ap);
 
+    // if msg did not fit in msg_buff then construct it in an allocated buffer;
+    // if the allocate fails then the truncated msg_buff is logged; 
+    // a negative len is an encoding error, and an empty msg is logged
+    if (len < 0) {
+        msg_buff[0] = '\0';
+    } else if ((size_t)len >= sizeof(msg_buff)) {
+        char * p = malloc(len+1);
+        if (p != NULL) {
+            va_start(ap, fmt);
+            vsnprintf(p, len+1, fmt, ap);
+            va_end(ap);
+            msg = p;
+        }
+    }
+
     // remove terminating newline
     len = strlen(msg);
     if (len > 0 && msg[len-1] == '\n') {
@@ -63,6 +79,11 @@ void logmsg(char *lvl, const char *func, char *fmt, ...)
     fprintf(stderr, "%s %s %s: %s\n",
            time2str(time_str, get_real_time_us(), false, true, true),
            lvl, func, msg);
+
+    // free msg, if it was allocated
+    if (msg != msg_buff) {
+        free(msg);
+    }
 }
 
 // -----------------  TIME UTILS  -----------------------------------------
@@ -36,6 +36,7 @@ SOFTWARE.
 #include <png.h>
 
 #include "util_png.h"
+#include "util_stats.h"
 #include "util_misc.h"
 
 //
@@ -51,9 +52,6 @@ SOFTWARE.
 //
 // XXX Possible Future Enhancements
 // - add user_error_fn, and user_warning_fn
-// - determine what the following code does, and would it be helpful
-//      int32_t number_of_passes = png_set_interlace_handling(png_ptr);
-//      png_read_update_info(png_ptr, png_info);
 // - implement max_image_dim
 //
 
@@ -69,6 +67,16 @@ SOFTWARE.
      (x) == PNG_COLOR_TYPE_GRAY_ALPHA ? "PNG_COLOR_TYPE_GRAY_ALPHA"  \
                                       : "????")
 
+#define BYTES_PER_PIXEL 4
+
+// libpng stores 16 bit samples big endian; png_set_swap is used to read and 
+// write them in the native byte order
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PNG_SWAP_16 true
+#else
+#define PNG_SWAP_16 false
+#endif
+
 //
 // variables
 //
@@ -77,6 +85,12 @@ SOFTWARE.
 // prototypes
 //
 
+static int32_t read_png(char* file_name, int32_t depth, void ** pixels_arg, 
+                        int32_t * width_arg, int32_t * height_arg,
+                        uint8_t ** icc_profile, int32_t * icc_profile_len);
+static int32_t write_png(char* file_name, int32_t depth, void * pixels, int32_t width, int32_t height,
+                         uint8_t * icc_profile, int32_t icc_profile_len);
+
 // -----------------  READ PNG FILE  ---------------------------------------------------
 
 //
@@ -88,27 +102,60 @@ SOFTWARE.
 // - pixels: the pixels_arg is malloced by read_png_file; the caller should free
 //   this memory when done; 4 bytes per pixel; in SDL_PIXELFORMAT_ABGR8888
 // - width_arg, height_arg: return the image width and height
+// - icc_profile, icc_profile_len: return the icc profile from the iCCP chunk,
+//   malloced, or NULL if the file has none; the caller should free this 
+//   memory; when icc_profile is NULL the profile is not returned
 //
 // Notes:          
-// - the only png file format currently supported is PNG_COLOR_TYPE_RGB_ALPHA
+// - all png color types and bit depths are supported; gray is expanded to rgb, 
+//   an alpha channel is added if there is none, and 16 bit samples are scaled 
+//   to 8 bits
 //
 
 int32_t read_png_file(char* file_name, int32_t max_image_dim,
-                   uint8_t ** pixels_arg, int32_t * width_arg, int32_t * height_arg)
+                   uint8_t ** pixels_arg, int32_t * width_arg, int32_t * height_arg,
+                   uint8_t ** icc_profile, int32_t * icc_profile_len)
+{
+    return read_png(file_name, 8, (void**)pixels_arg, width_arg, height_arg, 
+                    icc_profile, icc_profile_len);
+}
+
+//
+// Same as read_png_file, except the pixels are 4 uint16 per pixel, red, green,
+// blue and alpha, in the native byte order; 8 bit samples are scaled to 16 bits.
+//
+
+int32_t read_png_file16(char* file_name,
+                   uint16_t ** pixels_arg, int32_t * width_arg, int32_t * height_arg,
+                   uint8_t ** icc_profile, int32_t * icc_profile_len)
+{
+    return read_png(file_name, 16, (void**)pixels_arg, width_arg, height_arg, 
+                    icc_profile, icc_profile_len);
+}
+
+// read the png file, with depth 8 or 16 bits per sample
+static int32_t read_png(char* file_name, int32_t depth, void ** pixels_arg, 
+                        int32_t * width_arg, int32_t * height_arg,
+                        uint8_t ** icc_profile, int32_t * icc_profile_len)
 {
     FILE        * fp           = NULL;
     png_structp   png_ptr      = NULL;
     png_infop     png_info     = NULL;
-    uint8_t     * pixels       = NULL;
-    uint8_t    ** row_pointers = NULL;
+    uint8_t     * volatile pixels = NULL;
+    uint8_t    ** volatile row_pointers = NULL;
+    uint8_t     * volatile icc = NULL;
+    int32_t       volatile icc_len = 0;
     uint8_t       hdr[8];
-    int32_t       len, width, height, color_type, rowbytes, y, ret;
-    int32_t       bit_depth __attribute__((unused));
+    int32_t       len, width, height, color_type, bit_depth, rowbytes, y, ret;
 
     // preset returns to caller
     *pixels_arg = NULL;
     *width_arg  = 0;
     *height_arg = 0;
+    if (icc_profile) {
+        *icc_profile = NULL;
+        *icc_profile_len = 0;
+    }
 
     // open file_name
     fp = fopen(file_name, "rb");
@@ -162,17 +209,63 @@ int32_t read_png_file(char* file_name, int32_t max_image_dim,
     DEBUG("width=%d height=%d color_type=%s bit_depth=%d\n",
           width, height, PNG_COLOR_TYPE_STR(color_type), bit_depth);
 
-    // currently this routine supports only PNG_COLOR_TYPE_RGB_ALPHA
-    if (color_type != PNG_COLOR_TYPE_RGB_ALPHA) {
-        ERROR("%s: unsupported color_type %s\n", file_name, PNG_COLOR_TYPE_STR(color_type));
-        goto error;
+    // get the icc profile, the libpng copy is freed by png_destroy_read_struct
+    if (icc_profile) {
+        png_charp   name;
+        png_bytep   profile;
+        png_uint_32 proflen;
+        int         compression_type;
+
+        if (png_get_iCCP(png_ptr, png_info, &name, &compression_type, &profile, &proflen) &&
+            proflen > 0)
+        {
+            icc = malloc(proflen);
+            if (icc == NULL) {
+                ERROR("%s: malloc icc profile failed, len=%d\n", file_name, proflen);
+                goto error;
+            }
+            memcpy(icc, profile, proflen);
+            icc_len = proflen;
+        }
+    }
+
+    // request transformations so that the rows read are rgba, with depth bits 
+    // per sample: palette and gray are expanded to rgb, transparency is converted
+    // to an alpha channel, an opaque alpha channel is added if there is none, and 
+    // the samples are scaled to the depth
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+    if (png_get_valid(png_ptr, png_info, PNG_INFO_tRNS)) {
+        png_set_tRNS_to_alpha(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(png_ptr);
+    }
+    if (depth == 16 && bit_depth < 16) {
+        png_set_expand_16(png_ptr);
+    } else if (depth == 8 && bit_depth == 16) {
+        png_set_scale_16(png_ptr);
     }
+    if (depth == 16 && PNG_SWAP_16) {
+        png_set_swap(png_ptr);
+    }
+    png_set_add_alpha(png_ptr, 0xffff, PNG_FILLER_AFTER);
+    png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, png_info);
 
     // get the number of bytes in a row, and
     // allocate memory for the pixels
     rowbytes = png_get_rowbytes(png_ptr,png_info);
     DEBUG("rowbytes=%d\n", rowbytes);
-    pixels = malloc(height*rowbytes);
+    if (rowbytes != (int64_t)width * BYTES_PER_PIXEL * depth / 8) {
+        ERROR("%s: unexpected rowbytes %d, width=%d depth=%d\n", file_name, rowbytes, width, depth);
+        goto error;
+    }
+    pixels = malloc((size_t)height*rowbytes);
     if (pixels == NULL) {
         ERROR("%s: malloc pixels failed, %dx%d\n", file_name, width, height);
         goto error;
@@ -180,8 +273,12 @@ int32_t read_png_file(char* file_name, int32_t max_image_dim,
 
     // allocate and init row_pointers
     row_pointers = malloc(sizeof(void*) * height);
+    if (row_pointers == NULL) {
+        ERROR("%s: malloc row_pointers failed, height=%d\n", file_name, height);
+        goto error;
+    }
     for (y = 0; y < height; y++) {
-        row_pointers[y] = pixels + y * rowbytes;
+        row_pointers[y] = pixels + (size_t)y * rowbytes;
     }
 
     // read the image
@@ -191,6 +288,10 @@ int32_t read_png_file(char* file_name, int32_t max_image_dim,
     *width_arg  = width;
     *height_arg = height;
     *pixels_arg = pixels;
+    if (icc_profile) {
+        *icc_profile = icc;
+        *icc_profile_len = icc_len;
+    }
     ret = 0;
     goto cleanup;
 
@@ -207,6 +308,7 @@ cleanup:
     free(row_pointers);
     if (ret == -1) {
         free(pixels);
+        free(icc);
     }
     png_destroy_read_struct(&png_ptr, &png_info, NULL);
     return ret;
@@ -219,23 +321,46 @@ cleanup:
 // - file_name: pathname of the png file to be written
 // - pixels: 4 bytes per pixel; in SDL_PIXELFORMAT_ABGR8888
 // - width, height: the image width and height
+// - icc_profile, icc_profile_len: when icc_profile is not NULL it is embedded
+//   in the file, in an iCCP chunk
 //
 // Notes:
 // - created png file color_type is PNG_COLOR_TYPE_RGB_ALPHA
 //
 
 int32_t write_png_file(char* file_name,
-                       uint8_t * pixels, int32_t width, int32_t height)
+                       uint8_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len)
+{
+    return write_png(file_name, 8, pixels, width, height, icc_profile, icc_profile_len);
+}
+
+//
+// Same as write_png_file, except the pixels are 4 uint16 per pixel, red, green, 
+// blue and alpha, in the native byte order; the png file bit depth is 16.
+//
+
+int32_t write_png_file16(char* file_name,
+                       uint16_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len)
 {
-    #define BYTES_PER_PIXEL 4
+    return write_png(file_name, 16, pixels, width, height, icc_profile, icc_profile_len);
+}
 
+// write the png file, with depth 8 or 16 bits per sample
+static int32_t write_png(char* file_name, int32_t depth, void * pixels, int32_t width, int32_t height,
+                         uint8_t * icc_profile, int32_t icc_profile_len)
+{
     FILE      * fp        = NULL;
     png_structp png_ptr   = NULL;
     png_infop   png_info  = NULL;
-    png_bytep   row_pointers[height];    
-    int32_t     color_type, bit_depth, y, ret;
+    png_bytep * volatile row_pointers = NULL;
+    size_t      rowbytes  = (size_t)width * BYTES_PER_PIXEL * depth / 8;
+    int32_t     color_type, y, ret;
+    uint64_t    start;
 
     // create file 
+    start = STATS_SPAN_BEGIN();
     fp = fopen(file_name, "wb");
     if (!fp) {
         ERROR("%s: fopen failed, %s\n", file_name, strerror(errno));
@@ -244,9 +369,13 @@ int32_t write_png_file(char* file_name,
 
     // initialize
     color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-    bit_depth = 8;
+    row_pointers = malloc(sizeof(png_bytep) * height);
+    if (row_pointers == NULL) {
+        ERROR("%s: malloc row_pointers failed, height=%d\n", file_name, height);
+        goto error;
+    }
     for (y = 0; y < height; y++) {
-        row_pointers[y] = &pixels[y*width*BYTES_PER_PIXEL];
+        row_pointers[y] = (png_bytep)pixels + y * rowbytes;
     }
 
     png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -270,15 +399,25 @@ int32_t write_png_file(char* file_name,
 
     // write file header 
     png_set_IHDR(png_ptr, png_info, width, height,
-                 bit_depth, color_type, PNG_INTERLACE_NONE,
+                 depth, color_type, PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    if (icc_profile) {
+        png_set_iCCP(png_ptr, png_info, "ICC Profile", PNG_COMPRESSION_TYPE_BASE, 
+                     icc_profile, icc_profile_len);
+    }
     png_write_info(png_ptr, png_info);
 
+    // the 16 bit samples are converted to big endian as they are written
+    if (depth == 16 && PNG_SWAP_16) {
+        png_set_swap(png_ptr);
+    }
+
     // write bytes 
     png_write_image(png_ptr, row_pointers);
 
     // end write 
     png_write_end(png_ptr, NULL);
+    STATS_SPAN_END(STATS_STAGE_ENCODE, -1, start);
 
     // success return
     ret = 0;
@@ -294,6 +433,7 @@ cleanup:
     if (fp) {
         fclose(fp);
     }
+    free(row_pointers);
     png_destroy_write_struct(&png_ptr, &png_info);
     return ret;
 }
@@ -24,9 +24,19 @@ SOFTWARE.
 #define __UTIL_PNG_H__
 
 int32_t read_png_file(char* file_name, int32_t max_image_dim,
-                       uint8_t ** pixels, int32_t * width, int32_t * height);
+                       uint8_t ** pixels, int32_t * width, int32_t * height,
+                       uint8_t ** icc_profile, int32_t * icc_profile_len);
 
 int32_t write_png_file(char* file_name,
-                       uint8_t * pixels, int32_t width, int32_t height);
+                       uint8_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len);
+
+// 16 bits per sample, 4 uint16 per pixel in the native byte order
+int32_t read_png_file16(char* file_name,
+                       uint16_t ** pixels, int32_t * width, int32_t * height,
+                       uint8_t ** icc_profile, int32_t * icc_profile_len);
+int32_t write_png_file16(char* file_name,
+                       uint16_t * pixels, int32_t width, int32_t height,
+                       uint8_t * icc_profile, int32_t icc_profile_len);
 
 #endif
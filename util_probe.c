@@ -0,0 +1,273 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+
+#include "util_probe.h"
+#include "util_misc.h"
+
+//
+// The header of most files is contained in the first PROBE_READ_SIZE bytes,
+// so just one read is usually needed. For a jpeg file the markers that precede 
+// the SOF marker are skipped; if these are larger than PROBE_READ_SIZE, for 
+// example an exif segment with a large thumbnail, then the data that follows is 
+// read at its file offset. Only the exif orientation tag of the APP1 segment 
+// is parsed.
+//
+
+//
+// defines
+//
+
+#define PROBE_READ_SIZE 65536
+
+#define GET_BE16(p) (((p)[0] << 8) | (p)[1])
+#define GET_BE32(p) (((uint32_t)(p)[0] << 24) | ((p)[1] << 16) | ((p)[2] << 8) | (p)[3])
+
+//
+// typedefs
+//
+
+typedef struct {
+    int32_t fd;
+    uint8_t buff[PROBE_READ_SIZE];
+    int64_t buff_off;     // file offset of buff[0]
+    int32_t buff_len;
+} probe_file_t;
+
+//
+// variables
+//
+
+//
+// prototypes
+//
+
+static uint8_t * probe_get(probe_file_t * pf, int64_t off, int32_t len);
+static int32_t probe_png(probe_file_t * pf, probe_info_t * info);
+static int32_t probe_jpeg(probe_file_t * pf, probe_info_t * info);
+static int32_t probe_exif_orientation(uint8_t * p, int32_t len);
+
+// -----------------  PROBE IMAGE FILE  ----------------------------------------
+
+int32_t probe_image_file(char * file_name, probe_info_t * info)
+{
+    static const uint8_t png_sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    probe_file_t * pf;
+    uint8_t      * p;
+    int32_t        ret;
+
+    // preset return
+    info->type        = PROBE_TYPE_UNKNOWN;
+    info->width       = 0;
+    info->height      = 0;
+    info->orientation = 1;
+    info->bit_depth   = 8;
+
+    // open the file, and read the first PROBE_READ_SIZE bytes
+    pf = malloc(sizeof(probe_file_t));
+    if (pf == NULL) {
+        ERROR("allocate probe_file failed\n");
+        return -1;
+    }
+    pf->fd = open(file_name, O_RDONLY);
+    if (pf->fd < 0) {
+        ERROR("open %s, %s\n", file_name, strerror(errno));
+        free(pf);
+        return -1;
+    }
+    pf->buff_off = 0;
+    pf->buff_len = 0;
+
+    // determine the file type, and probe based on the type
+    if ((p = probe_get(pf, 0, 8)) != NULL && memcmp(p, png_sig, sizeof(png_sig)) == 0) {
+        info->type = PROBE_TYPE_PNG;
+        ret = probe_png(pf, info);
+    } else if (p != NULL && p[0] == 0xff && p[1] == 0xd8 && p[2] == 0xff) {
+        info->type = PROBE_TYPE_JPEG;
+        ret = probe_jpeg(pf, info);
+    } else {
+        ret = -1;
+    }
+    if (ret != 0 && info->type != PROBE_TYPE_UNKNOWN) {
+        ERROR("%s: failed to determine the image dimensions\n", file_name);
+    }
+
+    close(pf->fd);
+    free(pf);
+    return ret;
+}
+
+// return a pointer to len bytes of the file at offset off, reading the file if these 
+// bytes are not in the buffer; NULL is returned if the file does not contain these bytes
+static uint8_t * probe_get(probe_file_t * pf, int64_t off, int32_t len)
+{
+    if (len > PROBE_READ_SIZE) {
+        return NULL;
+    }
+
+    if (off < pf->buff_off || off + len > pf->buff_off + pf->buff_len) {
+        pf->buff_len = pread(pf->fd, pf->buff, PROBE_READ_SIZE, off);
+        pf->buff_off = off;
+        if (pf->buff_len < len) {
+            pf->buff_len = 0;
+            return NULL;
+        }
+    }
+
+    return pf->buff + (off - pf->buff_off);
+}
+
+// -----------------  PNG  -----------------------------------------------------
+
+// the png signature is followed by the IHDR chunk: 
+// length (4), "IHDR" (4), width (4), height (4), bit depth (1), ...
+static int32_t probe_png(probe_file_t * pf, probe_info_t * info)
+{
+    uint8_t * p;
+
+    if ((p = probe_get(pf, 8, 17)) == NULL || memcmp(p+4, "IHDR", 4) != 0) {
+        return -1;
+    }
+
+    info->width     = GET_BE32(p+8);
+    info->height    = GET_BE32(p+12);
+    info->bit_depth = (p[16] == 16 ? 16 : 8);
+    return (info->width > 0 && info->height > 0) ? 0 : -1;
+}
+
+// -----------------  JPEG  ----------------------------------------------------
+
+// walk the jpeg markers until the SOF marker, which contains the image dimensions;
+// the exif orientation is obtained from the APP1 segment, if present, which 
+// precedes the SOF marker
+static int32_t probe_jpeg(probe_file_t * pf, probe_info_t * info)
+{
+    int64_t   off = 2;
+    int32_t   marker, seg_len;
+    uint8_t * p;
+
+    while (true) {
+        // find the next marker, skipping fill bytes
+        if ((p = probe_get(pf, off, 2)) == NULL || p[0] != 0xff) {
+            return -1;
+        }
+        marker = p[1];
+        off += 2;
+        if (marker == 0xff) {
+            off--;
+            continue;
+        }
+
+        // standalone markers have no segment; 
+        // EOI or SOS before the SOF is an error
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+            continue;
+        }
+        if (marker == 0xd9 || marker == 0xda) {
+            return -1;
+        }
+
+        // get the segment length, which includes the length field
+        if ((p = probe_get(pf, off, 2)) == NULL || (seg_len = GET_BE16(p)) < 2) {
+            return -1;
+        }
+
+        // SOF markers are 0xc0 - 0xcf, except DHT (0xc4), JPG (0xc8) and DAC (0xcc);
+        // the segment is: length (2), precision (1), height (2), width (2), ...
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            if ((p = probe_get(pf, off, 7)) == NULL) {
+                return -1;
+            }
+            info->height = GET_BE16(p+3);
+            info->width  = GET_BE16(p+5);
+            return (info->width > 0 && info->height > 0) ? 0 : -1;
+        }
+
+        // APP1 exif segment
+        if (marker == 0xe1 && seg_len >= 2+6+8 &&
+            (p = probe_get(pf, off+2, seg_len-2)) != NULL &&
+            memcmp(p, "Exif\0\0", 6) == 0)
+        {
+            info->orientation = probe_exif_orientation(p+6, seg_len-2-6);
+        }
+
+        off += seg_len;
+    }
+}
+
+// return the orientation tag (0x112) of IFD0 of the exif tiff data, 
+// or 1 if it is not present or not valid
+static int32_t probe_exif_orientation(uint8_t * p, int32_t len)
+{
+    bool     le;
+    uint32_t ifd_off;
+    int32_t  i, count, tag, val;
+
+    #define GET16(q) (le ? ((q)[1] << 8) | (q)[0] : GET_BE16(q))
+    #define GET32(q) (le ? ((uint32_t)(q)[3] << 24) | ((q)[2] << 16) | ((q)[1] << 8) | (q)[0] : GET_BE32(q))
+
+    // tiff header: byte order "II" or "MM", 42, offset of IFD0
+    if (len < 8) {
+        return 1;
+    }
+    if (memcmp(p, "II", 2) == 0) {
+        le = true;
+    } else if (memcmp(p, "MM", 2) == 0) {
+        le = false;
+    } else {
+        return 1;
+    }
+    if (GET16(p+2) != 42) {
+        return 1;
+    }
+    ifd_off = GET32(p+4);
+    if (ifd_off > (uint32_t)len - 2) {
+        return 1;
+    }
+
+    // search the IFD0 entries, each is: tag (2), type (2), count (4), value (4)
+    count = GET16(p+ifd_off);
+    for (i = 0; i < count; i++) {
+        uint8_t * e = p + ifd_off + 2 + 12 * i;
+        if (e + 12 > p + len) {
+            break;
+        }
+        tag = GET16(e);
+        if (tag == 0x112) {
+            val = GET16(e+8);
+            return (val >= 1 && val <= 8) ? val : 1;
+        }
+    }
+    return 1;
+
+    #undef GET16
+    #undef GET32
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef __UTIL_PROBE_H__
+#define __UTIL_PROBE_H__
+
+#define PROBE_TYPE_UNKNOWN 0
+#define PROBE_TYPE_PNG     1
+#define PROBE_TYPE_JPEG    2
+
+typedef struct {
+    int32_t type;          // PROBE_TYPE_xxx
+    int32_t width;
+    int32_t height;
+    int32_t orientation;   // exif orientation 1 - 8, 1 is normal
+    int32_t bit_depth;     // bits per sample, 8 or 16
+} probe_info_t;
+
+// read just the header of a jpeg or png file, to determine the file type, the 
+// image width and height, the exif orientation, and the bit depth; returns -1 if 
+// the file is not a jpeg or png file, or the dimensions could not be determined, 
+// in which case info->type is still set if the file type was recognized
+int32_t probe_image_file(char * file_name, probe_info_t * info);
+
+#endif
@@ -0,0 +1,401 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "util_resample.h"
+#include "util_misc.h"
+
+//
+// Resampling in sRGB space, as the gpu does, darkens fine detail when an image
+// is reduced, because the average of the encoded values is darker than the 
+// encoded average of the light. Here the src pixels are converted to 16 bit 
+// linear light using a 256 entry table, filtered, and converted back using a 
+// 16K entry table. The 16 bit resample uses 64K entry tables, in both 
+// directions, which are created when first used; or, when linear light is not 
+// requested, filters the 16 bit values as they are.
+//
+// The filter is separable. The horizontal pass converts and filters each src 
+// row that is needed; the filtered rows are kept in a ring buffer that holds 
+// the rows used by one dst row, and the vertical pass combines them. The 
+// weights are 14 bit fixed point, and the inner loops are over contiguous 
+// uint16 arrays, so that the compiler vectorizes them.
+//
+
+//
+// defines
+//
+
+#define BYTES_PER_PIXEL  4
+#define WEIGHT_BITS      14
+#define WEIGHT_ONE       (1 << WEIGHT_BITS)
+#define LIN_TO_SRGB_BITS 14   // the linear to sRGB table is indexed by the top 14 bits
+
+//
+// typedefs
+//
+
+typedef struct {
+    int32_t   max_n;    // weight entries per dst pixel
+    int32_t * start;    // first src pixel of each dst pixel
+    int32_t * n;        // number of src pixels of each dst pixel
+    int32_t * weight;   // max_n weights for each dst pixel, the sum is WEIGHT_ONE
+} contrib_t;
+
+//
+// variables
+//
+
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+static uint16_t       srgb_to_lin[256];
+static uint8_t        lin_to_srgb[1 << LIN_TO_SRGB_BITS];
+
+static pthread_once_t table16_once = PTHREAD_ONCE_INIT;
+static uint16_t     * srgb16_to_lin;
+static uint16_t     * lin_to_srgb16;
+
+//
+// prototypes
+//
+
+static int32_t resample(void * src, int32_t depth, int32_t src_w, int32_t src_h, 
+                        double x, double y, double w, double h,
+                        void * dst, int32_t dst_w, int32_t dst_h, int32_t dst_pitch, bool linear_light);
+static void table_init(void);
+static void table16_init(void);
+static int32_t contrib_create(int32_t src_n, double s0, double sw, int32_t dst_n, contrib_t * c);
+static void contrib_free(contrib_t * c);
+static void filter_row(uint8_t * src, contrib_t * cx, int32_t dst_w, uint16_t * out);
+static void filter_row16(uint16_t * src, uint16_t * lut, contrib_t * cx, int32_t dst_w, uint16_t * out);
+
+// -----------------  RESAMPLE  ------------------------------------------------
+
+int32_t resample_linear(uint8_t * src, int32_t src_w, int32_t src_h, 
+                        double x, double y, double w, double h,
+                        uint8_t * dst, int32_t dst_w, int32_t dst_h)
+{
+    pthread_once(&table_once, table_init);
+    return resample(src, 8, src_w, src_h, x, y, w, h, dst, dst_w, dst_h, dst_w, true);
+}
+
+int32_t resample_16(uint16_t * src, int32_t src_w, int32_t src_h, 
+                    double x, double y, double w, double h,
+                    uint16_t * dst, int32_t dst_w, int32_t dst_h, int32_t dst_pitch,
+                    bool linear_light)
+{
+    if (linear_light) {
+        pthread_once(&table16_once, table16_init);
+        if (srgb16_to_lin == NULL || lin_to_srgb16 == NULL) {
+            return -1;
+        }
+    }
+    return resample(src, 16, src_w, src_h, x, y, w, h, dst, dst_w, dst_h, dst_pitch, linear_light);
+}
+
+// resample with depth 8 or 16 bits per sample; the 8 bit resample is always 
+// in linear light; dst_pitch is in pixels
+static int32_t resample(void * src, int32_t depth, int32_t src_w, int32_t src_h, 
+                        double x, double y, double w, double h,
+                        void * dst, int32_t dst_w, int32_t dst_h, int32_t dst_pitch, bool linear_light)
+{
+    contrib_t  cx, cy;
+    uint16_t * ring = NULL;
+    uint32_t * acc = NULL;
+    int32_t    ring_n, row_len, next_row, dy, sy, k, i;
+
+    memset(&cx, 0, sizeof(cx));
+    memset(&cy, 0, sizeof(cy));
+    row_len = dst_w * BYTES_PER_PIXEL;
+    if (contrib_create(src_w, x, w, dst_w, &cx) != 0 || contrib_create(src_h, y, h, dst_h, &cy) != 0) {
+        goto error;
+    }
+    ring_n = cy.max_n;
+    ring = malloc((size_t)ring_n * row_len * sizeof(uint16_t));
+    acc = malloc((size_t)row_len * sizeof(uint32_t));
+    if (ring == NULL || acc == NULL) {
+        ERROR("allocate resample buffers failed, dst %dx%d\n", dst_w, dst_h);
+        goto error;
+    }
+
+    next_row = 0;
+    for (dy = 0; dy < dst_h; dy++) {
+        int32_t   start = cy.start[dy];
+        int32_t   n = cy.n[dy];
+        int32_t * weight = &cy.weight[dy * cy.max_n];
+
+        // horizontally filter the src rows that are needed, and not yet in the ring
+        if (next_row < start) {
+            next_row = start;
+        }
+        for (sy = next_row; sy < start + n; sy++) {
+            uint16_t * ring_row = ring + (size_t)(sy % ring_n) * row_len;
+            if (depth == 8) {
+                filter_row((uint8_t*)src + (size_t)sy * src_w * BYTES_PER_PIXEL, &cx, dst_w, ring_row);
+            } else {
+                filter_row16((uint16_t*)src + (size_t)sy * src_w * BYTES_PER_PIXEL, 
+                             linear_light ? srgb16_to_lin : NULL, &cx, dst_w, ring_row);
+            }
+        }
+        next_row = start + n;
+
+        // vertically filter the rows in the ring
+        memset(acc, 0, row_len * sizeof(uint32_t));
+        for (k = 0; k < n; k++) {
+            uint16_t * row = ring + (size_t)((start + k) % ring_n) * row_len;
+            uint32_t   wt = weight[k];
+            for (i = 0; i < row_len; i++) {
+                acc[i] += wt * row[i];
+            }
+        }
+
+        // convert to sRGB; alpha is not gamma encoded
+        if (depth == 8) {
+            uint8_t * out = (uint8_t*)dst + (size_t)dy * dst_pitch * BYTES_PER_PIXEL;
+            for (i = 0; i < row_len; i += BYTES_PER_PIXEL) {
+                out[i+0] = lin_to_srgb[acc[i+0] >> (WEIGHT_BITS + 16 - LIN_TO_SRGB_BITS)];
+                out[i+1] = lin_to_srgb[acc[i+1] >> (WEIGHT_BITS + 16 - LIN_TO_SRGB_BITS)];
+                out[i+2] = lin_to_srgb[acc[i+2] >> (WEIGHT_BITS + 16 - LIN_TO_SRGB_BITS)];
+                out[i+3] = acc[i+3] >> (WEIGHT_BITS + 8);
+            }
+        } else if (linear_light) {
+            uint16_t * out = (uint16_t*)dst + (size_t)dy * dst_pitch * BYTES_PER_PIXEL;
+            for (i = 0; i < row_len; i += BYTES_PER_PIXEL) {
+                out[i+0] = lin_to_srgb16[acc[i+0] >> WEIGHT_BITS];
+                out[i+1] = lin_to_srgb16[acc[i+1] >> WEIGHT_BITS];
+                out[i+2] = lin_to_srgb16[acc[i+2] >> WEIGHT_BITS];
+                out[i+3] = acc[i+3] >> WEIGHT_BITS;
+            }
+        } else {
+            uint16_t * out = (uint16_t*)dst + (size_t)dy * dst_pitch * BYTES_PER_PIXEL;
+            for (i = 0; i < row_len; i++) {
+                out[i] = acc[i] >> WEIGHT_BITS;
+            }
+        }
+    }
+
+    contrib_free(&cx);
+    contrib_free(&cy);
+    free(ring);
+    free(acc);
+    return 0;
+
+error:
+    contrib_free(&cx);
+    contrib_free(&cy);
+    free(ring);
+    free(acc);
+    return -1;
+}
+
+// convert a src row to linear light and horizontally filter it, to dst_w 
+// 16 bit linear pixels
+static void filter_row(uint8_t * src, contrib_t * cx, int32_t dst_w, uint16_t * out)
+{
+    int32_t dx, k;
+
+    for (dx = 0; dx < dst_w; dx++) {
+        uint8_t * s = src + cx->start[dx] * BYTES_PER_PIXEL;
+        int32_t * weight = &cx->weight[dx * cx->max_n];
+        int32_t   n = cx->n[dx];
+        uint32_t  r = 0, g = 0, b = 0, a = 0;
+
+        for (k = 0; k < n; k++, s += BYTES_PER_PIXEL) {
+            r += weight[k] * srgb_to_lin[s[0]];
+            g += weight[k] * srgb_to_lin[s[1]];
+            b += weight[k] * srgb_to_lin[s[2]];
+            a += weight[k] * (s[3] * 257);
+        }
+        out[0] = (r + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[1] = (g + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[2] = (b + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[3] = (a + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out += BYTES_PER_PIXEL;
+    }
+}
+
+// same as filter_row, for 16 bit src pixels; if lut is not NULL the red, 
+// green and blue samples are converted by it
+static void filter_row16(uint16_t * src, uint16_t * lut, contrib_t * cx, int32_t dst_w, uint16_t * out)
+{
+    int32_t dx, k;
+
+    for (dx = 0; dx < dst_w; dx++) {
+        uint16_t * s = src + cx->start[dx] * BYTES_PER_PIXEL;
+        int32_t  * weight = &cx->weight[dx * cx->max_n];
+        int32_t    n = cx->n[dx];
+        uint32_t   r = 0, g = 0, b = 0, a = 0;
+
+        if (lut) {
+            for (k = 0; k < n; k++, s += BYTES_PER_PIXEL) {
+                r += weight[k] * lut[s[0]];
+                g += weight[k] * lut[s[1]];
+                b += weight[k] * lut[s[2]];
+                a += weight[k] * s[3];
+            }
+        } else {
+            for (k = 0; k < n; k++, s += BYTES_PER_PIXEL) {
+                r += weight[k] * s[0];
+                g += weight[k] * s[1];
+                b += weight[k] * s[2];
+                a += weight[k] * s[3];
+            }
+        }
+        out[0] = (r + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[1] = (g + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[2] = (b + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out[3] = (a + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        out += BYTES_PER_PIXEL;
+    }
+}
+
+// -----------------  SUPPORT  -------------------------------------------------
+
+static void table_init(void)
+{
+    int32_t i;
+    double  v;
+
+    for (i = 0; i < 256; i++) {
+        v = i / 255.;
+        v = (v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4));
+        srgb_to_lin[i] = nearbyint(v * 65535);
+    }
+
+    // each entry is the sRGB value at the center of the entry's linear range
+    for (i = 0; i < (1 << LIN_TO_SRGB_BITS); i++) {
+        v = (i + 0.5) / (1 << LIN_TO_SRGB_BITS);
+        v = (v <= 0.0031308 ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055);
+        lin_to_srgb[i] = nearbyint(v * 255);
+    }
+    lin_to_srgb[0] = 0;
+}
+
+static void table16_init(void)
+{
+    int32_t i;
+    double  v;
+
+    srgb16_to_lin = malloc(65536 * sizeof(uint16_t));
+    lin_to_srgb16 = malloc(65536 * sizeof(uint16_t));
+    if (srgb16_to_lin == NULL || lin_to_srgb16 == NULL) {
+        ERROR("allocate 16 bit resample tables failed\n");
+        return;
+    }
+
+    for (i = 0; i < 65536; i++) {
+        v = i / 65535.;
+        v = (v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4));
+        srgb16_to_lin[i] = nearbyint(v * 65535);
+
+        v = i / 65535.;
+        v = (v <= 0.0031308 ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055);
+        lin_to_srgb16[i] = nearbyint(v * 65535);
+    }
+}
+
+// determine the src pixels, and their weights, that contribute to each of the 
+// dst_n pixels; the src region is s0 to s0+sw; when reducing, the weight of a 
+// src pixel is the amount that it overlaps the dst pixel's area, and when 
+// enlarging the weights are bilinear; the src pixels beyond the edges of the 
+// image are replaced by the edge pixels
+static int32_t contrib_create(int32_t src_n, double s0, double sw, int32_t dst_n, contrib_t * c)
+{
+    double   scale = sw / dst_n;
+    double   center, lo, hi, f, total, * wd;
+    int32_t  d, k, k0, k1, first, last, sum, max_k, *weight;
+
+    c->max_n = (scale > 1 ? (int32_t)ceil(scale) + 2 : 2);
+    c->start = malloc(dst_n * sizeof(int32_t));
+    c->n = malloc(dst_n * sizeof(int32_t));
+    c->weight = malloc((size_t)dst_n * c->max_n * sizeof(int32_t));
+    wd = malloc(c->max_n * sizeof(double));
+    if (c->start == NULL || c->n == NULL || c->weight == NULL || wd == NULL) {
+        ERROR("allocate resample weights failed, dst_n=%d max_n=%d\n", dst_n, c->max_n);
+        free(wd);
+        return -1;
+    }
+
+    for (d = 0; d < dst_n; d++) {
+        weight = &c->weight[d * c->max_n];
+        center = s0 + (d + 0.5) * scale;
+
+        // determine the src pixels, k0 to k1, and their weights, which may be 
+        // beyond the edges of the image
+        if (scale > 1) {
+            lo = center - scale / 2;
+            hi = center + scale / 2;
+            k0 = floor(lo);
+            k1 = ceil(hi) - 1;
+        } else {
+            lo = center - 0.5;
+            k0 = floor(lo);
+            k1 = k0 + 1;
+            f = lo - k0;
+        }
+        if (k1 - k0 + 1 > c->max_n) {
+            k1 = k0 + c->max_n - 1;
+        }
+
+        // the pixels beyond the edges are replaced by the edge pixels
+        first = (k0 < 0 ? 0 : k0 > src_n-1 ? src_n-1 : k0);
+        last  = (k1 < 0 ? 0 : k1 > src_n-1 ? src_n-1 : k1);
+        memset(wd, 0, (last - first + 1) * sizeof(double));
+        total = 0;
+        for (k = k0; k <= k1; k++) {
+            double wk = (scale > 1 ? fmin(hi, k+1) - fmax(lo, k) : (k == k0 ? 1 - f : f));
+            int32_t i = (k < first ? first : k > last ? last : k) - first;
+            wd[i] += wk;
+            total += wk;
+        }
+
+        // convert to fixed point that sums to WEIGHT_ONE; the rounding 
+        // error is added to the largest weight
+        c->start[d] = first;
+        c->n[d] = last - first + 1;
+        sum = 0;
+        max_k = 0;
+        for (k = 0; k < c->n[d]; k++) {
+            weight[k] = nearbyint(wd[k] / total * WEIGHT_ONE);
+            sum += weight[k];
+            if (weight[k] > weight[max_k]) {
+                max_k = k;
+            }
+        }
+        weight[max_k] += WEIGHT_ONE - sum;
+    }
+
+    free(wd);
+    return 0;
+}
+
+static void contrib_free(contrib_t * c)
+{
+    free(c->start);
+    free(c->n);
+    free(c->weight);
+}
@@ -0,0 +1,43 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __UTIL_RESAMPLE_H__
+#define __UTIL_RESAMPLE_H__
+
+// resample the x,y,w,h region of the src image to the dst image, in linear light;
+// the region is in src pixels and may be fractional; the pixels are 4 bytes per 
+// pixel, with red, green and blue sRGB encoded; the dst is an area average of 
+// the src when reducing, and is bilinear when enlarging; returns -1 if memory 
+// could not be allocated
+int32_t resample_linear(uint8_t * src, int32_t src_w, int32_t src_h, 
+                        double x, double y, double w, double h,
+                        uint8_t * dst, int32_t dst_w, int32_t dst_h);
+
+// same as resample_linear, except the pixels are 4 uint16 per pixel, the dst 
+// rows are dst_pitch pixels apart, and the resampling is in linear light only 
+// when linear_light is set
+int32_t resample_16(uint16_t * src, int32_t src_w, int32_t src_h, 
+                    double x, double y, double w, double h,
+                    uint16_t * dst, int32_t dst_w, int32_t dst_h, int32_t dst_pitch,
+                    bool linear_light);
+
+#endif
@@ -35,6 +35,7 @@ SOFTWARE.
 #include <inttypes.h>
 #include <limits.h>
 #include <time.h>
+#include <math.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -46,6 +47,7 @@ SOFTWARE.
 #include "util_sdl_button_sound.h"
 #include "util_png.h"
 #include "util_jpeg.h"
+#include "util_stats.h"
 #include "util_misc.h"
 
 //
@@ -54,6 +56,8 @@ SOFTWARE.
 
 #define MAX_FONT 2
 
+#define MAX_ATLAS_DIM 4096
+
 #define EVENT_INIT \
     do { \
         bzero(sdl_event_reg_tbl, sizeof(sdl_event_reg_tbl)); \
@@ -62,10 +66,20 @@ SOFTWARE.
 
 #define ENABLE_BUTTON_SOUND
 
+#define FLASH_MS 250
+
+#define MAX_TEXT_CACHE       256
+#define MAX_TEXT_CACHE_HASH  512   // must be power of 2
+#define MAX_TEXT_CACHE_STR   128
+
 #define min(a,b) \
    ({ __typeof__ (a) _a = (a); \
        __typeof__ (b) _b = (b); \
      _a < _b ? _a : _b; })
+#define max(a,b) \
+   ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+     _a > _b ? _a : _b; })
 
 //
 // typedefs
@@ -83,6 +97,44 @@ typedef struct {
     int32_t type;
 } sdl_event_reg_t;
 
+typedef struct {
+    SDL_Texture * texture;
+    int32_t       w;
+    int32_t       h;
+    int32_t       font_id;
+    int32_t       fg_color;
+    int32_t       bg_color;
+    bool          underline;
+    uint32_t      hash;
+    int32_t       hash_next;
+    int32_t       lru_prev;
+    int32_t       lru_next;
+    char          str[MAX_TEXT_CACHE_STR];
+} sdl_text_cache_t;
+
+typedef struct {
+    int32_t y;
+    int32_t h;
+    int32_t x_used;
+} sdl_atlas_shelf_t;
+
+typedef struct {
+    SDL_Texture       * texture;
+    sdl_atlas_shelf_t * shelf;
+    int32_t             max_shelf;
+    int32_t             y_used;
+    // the quads queued by sdl_atlas_render
+    int32_t             max_quad;
+    int32_t             alloc_quad;
+#if SDL_VERSION_ATLEAST(2,0,18)
+    SDL_Vertex        * vertex;
+    int               * index;
+#else
+    SDL_Rect          * quad_src;
+    SDL_Rect          * quad_dst;
+#endif
+} sdl_atlas_t;
+
 //
 // variables
 //
@@ -95,6 +147,8 @@ static int32_t          sdl_win_height;
 static bool             sdl_win_minimized;
 
 static char             sdl_screenshot_prefix[100];
+static bool             sdl_flash_active;
+static uint32_t         sdl_flash_end_ms;
 
 static Mix_Chunk      * sdl_button_sound;
 
@@ -102,6 +156,19 @@ static sdl_font_t       sdl_font[MAX_FONT];
 
 static sdl_event_reg_t  sdl_event_reg_tbl[SDL_EVENT_MAX];
 static int32_t          sdl_event_max;
+static uint32_t         sdl_user_event_type = (uint32_t)-1;
+
+static sdl_text_cache_t sdl_text_cache[MAX_TEXT_CACHE];
+static int32_t          sdl_text_cache_hash_head[MAX_TEXT_CACHE_HASH];
+static int32_t          sdl_max_text_cache;
+static int32_t          sdl_text_cache_lru_head;
+static int32_t          sdl_text_cache_lru_tail;
+
+static sdl_atlas_t    * sdl_atlas;
+static int32_t          sdl_max_atlas;
+static int32_t          sdl_atlas_dim;
+static atlas_slot_t   * sdl_atlas_free_slot;
+static int32_t          sdl_max_atlas_free_slot;
 
 static uint32_t         sdl_color_to_rgba[] = {
                             //    red           green          blue    alpha
@@ -124,6 +191,11 @@ static uint32_t         sdl_color_to_rgba[] = {
 
 static void sdl_exit_handler(void);
 static void sdl_set_color(int32_t color); 
+static SDL_Texture * sdl_text_to_texture(TTF_Font * font, int32_t fg_color, int32_t bg_color, char * str);
+static void sdl_text_cache_reset(void);
+static sdl_text_cache_t * sdl_text_cache_get(int32_t font_id, bool underline, int32_t fg_color, 
+                                             int32_t bg_color, char * str);
+static void sdl_render_copy_subpixel(SDL_Texture * src, frect_t * srcrect, SDL_Rect * dstrect);
 
 // 
 // inline procedures
@@ -196,6 +268,7 @@ int32_t sdl_init(int32_t w, int32_t h, char * screenshot_prefix, int32_t * max_t
         ERROR("TTF_Init failed\n");
         return -1;
     }
+    sdl_text_cache_reset();
 
     // search for FreeMonoBold.ttf font file in possible locations
     // note - fonts can be installed using:
@@ -269,9 +342,20 @@ int32_t sdl_init(int32_t w, int32_t h, char * screenshot_prefix, int32_t * max_t
                                sdl_renderer_info.max_texture_height);
     }
 
+    // the atlas textures are square, with dimension limited by max texture size
+    sdl_atlas_dim = min(MAX_ATLAS_DIM, min(sdl_renderer_info.max_texture_width, 
+                                           sdl_renderer_info.max_texture_height));
+
     // currently the SDL Text Input feature is not being used here
     SDL_StopTextInput();
 
+    // register the SDL event type used by sdl_push_user_event
+    sdl_user_event_type = SDL_RegisterEvents(1);
+    if (sdl_user_event_type == (uint32_t)-1) {
+        ERROR("SDL_RegisterEvents failed\n");
+        return -1;
+    }
+
     // register exit handler
     atexit(sdl_exit_handler);
 
@@ -283,14 +367,18 @@ int32_t sdl_init(int32_t w, int32_t h, char * screenshot_prefix, int32_t * max_t
 static void sdl_exit_handler(void)
 {
     int32_t i;
-    
-    usleep(1000000);
 
+    // if the button sound is playing then wait, for up to 1 second, for it to finish
     if (sdl_button_sound) {
+        for (i = 0; i < 100 && Mix_Playing(-1); i++) {
+            usleep(10000);
+        }
         Mix_FreeChunk(sdl_button_sound);
         Mix_CloseAudio();
     }
 
+    sdl_text_cache_reset();
+
     for (i = 0; i < MAX_FONT; i++) {
         TTF_CloseFont(sdl_font[i].font);
     }
@@ -325,12 +413,17 @@ void sdl_display_init(void)
 
 void sdl_display_present(void)
 {
+    // while the display is being flashed, see sdl_print_screen, the window is white
+    if (sdl_flash_active) {
+        SDL_SetRenderDrawColor(sdl_renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+        SDL_RenderClear(sdl_renderer);
+    }
     SDL_RenderPresent(sdl_renderer);
 }
 
 // -----------------  PANE SUPPORT ROUTINES  ---------------------------- 
 
-void sdl_init_pane(rect_t * pane_full, rect_t * pane, int16_t x, int16_t y, int16_t w, int16_t h)
+void sdl_init_pane(rect_t * pane_full, rect_t * pane, int32_t x, int32_t y, int32_t w, int32_t h)
 {
     pane_full->x = x;
     pane_full->y = y;
@@ -404,6 +497,17 @@ void sdl_event_register(int32_t event_id, int32_t event_type, rect_t * pos_arg)
 }
 
 sdl_event_t * sdl_poll_event(void)
+{
+    return sdl_wait_event(0);
+}
+
+// wait for an event; timeout_ms values:
+// - 0:  don't wait, same as sdl_poll_event
+// - >0: wait up to timeout_ms, SDL_EVENT_NONE is returned if the timeout expires
+// - <0: wait until an event occurs
+// while the display is being flashed the wait is limited to the end of the
+// flash, and SDL_EVENT_FLASH_DONE is then returned so the caller will redraw
+sdl_event_t * sdl_wait_event(int32_t timeout_ms)
 {
     #define AT_POS(X,Y,pos) (((X) >= (pos).x) && \
                              ((X) < (pos).x + (pos).w) && \
@@ -441,6 +545,7 @@ sdl_event_t * sdl_poll_event(void)
 
     SDL_Event ev;
     int32_t i;
+    uint32_t deadline_ms;
 
     static sdl_event_t event;
     static int32_t     mouse_button_state; 
@@ -451,10 +556,39 @@ sdl_event_t * sdl_poll_event(void)
     bzero(&event, sizeof(event));
     event.event = SDL_EVENT_NONE;
 
+    // if the display is being flashed then check for the flash done
+    if (sdl_flash_active) {
+        int32_t flash_remaining_ms = (int32_t)(sdl_flash_end_ms - SDL_GetTicks());
+        if (flash_remaining_ms <= 0) {
+            sdl_flash_active = false;
+            event.event = SDL_EVENT_FLASH_DONE;
+            return &event;
+        }
+        if (timeout_ms < 0 || timeout_ms > flash_remaining_ms) {
+            timeout_ms = flash_remaining_ms;
+        }
+    }
+    deadline_ms = SDL_GetTicks() + (timeout_ms > 0 ? timeout_ms : 0);
+
     while (true) {
-        // get the next event, break out of loop if no event
-        if (SDL_PollEvent(&ev) == 0) {
-            break;
+        // get the next event, waiting for it as specified by timeout_ms; 
+        // break out of loop if no event
+        if (timeout_ms < 0) {
+            if (SDL_WaitEvent(&ev) == 0) {
+                ERROR("SDL_WaitEvent failed, %s\n", SDL_GetError());
+                break;
+            }
+        } else {
+            int32_t remaining_ms = (int32_t)(deadline_ms - SDL_GetTicks());
+            if (remaining_ms <= 0) {
+                if (SDL_PollEvent(&ev) == 0) {
+                    break;
+                }
+            } else {
+                if (SDL_WaitEventTimeout(&ev, remaining_ms) == 0) {
+                    break;
+                }
+            }
         }
 
         // process the SDL event, this code
@@ -720,12 +854,22 @@ sdl_event_t * sdl_poll_event(void)
             }
             break; }
 
+        case SDL_RENDER_TARGETS_RESET: {
+            DEBUG("got event SDL_RENDER_TARGETS_RESET\n");
+            event.event = SDL_EVENT_RENDER_TARGETS_RESET;
+            break; }
+
         case SDL_QUIT: {
             DEBUG("got event SDL_QUIT\n");
             event.event = SDL_EVENT_QUIT;
             break; }
 
         default: {
+            // user event, pushed by sdl_push_user_event
+            if (ev.type == sdl_user_event_type) {
+                event.event = ev.user.code;
+                break;
+            }
             DEBUG("got event %d - not supported\n", ev.type);
             break; }
         }
@@ -739,6 +883,22 @@ sdl_event_t * sdl_poll_event(void)
     return &event;
 }
 
+// push an event that will be returned by sdl_poll_event or sdl_wait_event;
+// this can be called from any thread, for example to wake the main thread
+// when background work has completed; the event_id should be in the range
+// SDL_EVENT_USER_START to SDL_EVENT_USER_END
+void sdl_push_user_event(int32_t event_id)
+{
+    SDL_Event ev;
+
+    bzero(&ev, sizeof(ev));
+    ev.type = sdl_user_event_type;
+    ev.user.code = event_id;
+    if (SDL_PushEvent(&ev) < 0) {
+        ERROR("SDL_PushEvent failed, %s\n", SDL_GetError());
+    }
+}
+
 void sdl_play_event_sound(void)   
 {
     if (sdl_button_sound) {
@@ -750,20 +910,37 @@ void sdl_play_event_sound(void)
 
 void sdl_print_screen(char *file_name, bool flash_display, rect_t * rect_arg) 
 {
-    uint8_t * pixels = NULL;
-    SDL_Rect  rect;
-    int32_t   ret, len;
+    sdl_print_texture(file_name, flash_display, NULL, rect_arg, NULL, 0);
+}
+
+// write the rect_arg region of the texture, which must be a render target texture,
+// to file_name; if texture is NULL then the window is written; rendering to an 
+// offscreen render target texture, and reading back from it, is preferred because 
+// the contents of the window are not defined after sdl_display_present;
+// if icc_profile is not NULL then it is embedded in the file
+void sdl_print_texture(char *file_name, bool flash_display, texture_t texture, rect_t * rect_arg,
+                       uint8_t * icc_profile, int32_t icc_profile_len) 
+{
+    uint8_t     * pixels = NULL;
+    SDL_Texture * prior_target;
+    SDL_Rect      rect;
+    int32_t       ret, len;
+    uint64_t      start;
 
     // if caller has supplied region to print then 
     //   init rect to print with caller supplied position
     // else
-    //   init rect to print with entire window
+    //   init rect to print with entire window or texture
     // endif
     if (rect_arg) {
         rect.x = rect_arg->x;
         rect.y = rect_arg->y;
         rect.w = rect_arg->w;
         rect.h = rect_arg->h;
+    } else if (texture) {
+        rect.x = 0;
+        rect.y = 0;
+        SDL_QueryTexture((SDL_Texture *)texture, NULL, NULL, &rect.w, &rect.h);
     } else {
         rect.x = 0;
         rect.y = 0;
@@ -772,27 +949,41 @@ void sdl_print_screen(char *file_name, bool flash_display, rect_t * rect_arg)
     }
 
     // allocate memory for pixels
-    pixels = calloc(1, rect.w * rect.h * BYTES_PER_PIXEL);
+    pixels = malloc(rect.w * rect.h * BYTES_PER_PIXEL);
     if (pixels == NULL) {
         ERROR("allocate pixels failed\n");
         return;
     }
 
-    // copy entire display to pixels
+    // copy the texture or display to pixels; 
+    // the queued render commands are flushed first, and SDL_RenderReadPixels 
+    // then waits for the gpu to complete them before reading, so the pixels 
+    // read are those of the completed frame
+    start = STATS_SPAN_BEGIN();
+    prior_target = SDL_GetRenderTarget(sdl_renderer);
+    if (SDL_SetRenderTarget(sdl_renderer, (SDL_Texture *)texture) != 0) {
+        ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+        free(pixels);
+        return;
+    }
+#if SDL_VERSION_ATLEAST(2,0,10)
+    SDL_RenderFlush(sdl_renderer);
+#endif
     ret = SDL_RenderReadPixels(sdl_renderer, 
                                &rect, 
                                SDL_PIXELFORMAT_ABGR8888, 
                                pixels, 
                                rect.w * BYTES_PER_PIXEL);
+    SDL_SetRenderTarget(sdl_renderer, prior_target);
+    STATS_SPAN_END(STATS_STAGE_READBACK, -1, start);
     if (ret < 0) {
         ERROR("SDL_RenderReadPixels, %s\n", SDL_GetError());
         free(pixels);
         return;
     }
 
-
-#if 1
-    // sanity check the pixels
+#ifdef ENABLE_READBACK_SANITY_CHECK
+    // sanity check the pixels, this scans all pixels so it is enabled only for debug
     { int32_t i, count = 0;
     uint32_t *p = (uint32_t*)pixels;
     for (i = 0; i < rect.w * rect.h; i++) {
@@ -809,12 +1000,12 @@ void sdl_print_screen(char *file_name, bool flash_display, rect_t * rect_arg)
     // filename must have .jpg or .png extension
     len = strlen(file_name);
     if (len > 4 && strcmp(file_name+len-4, ".jpg") == 0) {
-        ret = write_jpeg_file(file_name, pixels, rect.w, rect.h);
+        ret = write_jpeg_file(file_name, pixels, rect.w, rect.h, icc_profile, icc_profile_len);
         if (ret != 0) {
             ERROR("write_jpeg_file %s failed\n", file_name);
         }
     } else if (len > 4 && strcmp(file_name+len-4, ".png") == 0) {
-        ret = write_png_file(file_name, pixels, rect.w, rect.h);
+        ret = write_png_file(file_name, pixels, rect.w, rect.h, icc_profile, icc_profile_len);
         if (ret != 0) {
             ERROR("write_png_file %s failed\n", file_name);
         }
@@ -827,24 +1018,26 @@ void sdl_print_screen(char *file_name, bool flash_display, rect_t * rect_arg)
         return;
     }
 
-    // it worked, flash display if enabled;
-    // the caller must redraw the screen if flash_display is enabled
+    // it worked, flash display if enabled
     if (flash_display) {
-        rect_t screen_pane, dummy_pane;
-        rect_t rect = {0,0,sdl_win_width,sdl_win_height};
-        sdl_init_pane(&screen_pane, &dummy_pane,
-                      0, 0,
-                      sdl_win_width, sdl_win_height);
-        sdl_display_init();
-        sdl_render_fill_rect(&screen_pane, &rect, WHITE);
-        sdl_display_present();
-        usleep(250000);
+        sdl_flash_display();
     }
 
     // free pixels
     free(pixels);
 }
 
+// flash the display, to indicate a file was written; this does not wait for the flash,
+// instead sdl_display_present displays white until FLASH_MS has elapsed,
+// and then sdl_wait_event returns SDL_EVENT_FLASH_DONE; the caller must 
+// redraw the screen when it gets SDL_EVENT_FLASH_DONE
+void sdl_flash_display(void)
+{
+    sdl_flash_active = true;
+    sdl_flash_end_ms = SDL_GetTicks() + FLASH_MS;
+    sdl_display_present();
+}
+
 // -----------------  RENDER TEXT  -------------------------------------- 
 
 void sdl_render_text(rect_t * pane, int32_t row, int32_t col, int32_t font_id, char * str, 
@@ -856,39 +1049,34 @@ void sdl_render_text(rect_t * pane, int32_t row, int32_t col, int32_t font_id, c
 void sdl_render_text_with_event(rect_t * pane, int32_t row, int32_t col, int32_t font_id, char * str, 
         int32_t fg_color, int32_t bg_color, int32_t event_id)
 {
-    SDL_Surface    * surface = NULL;
-    SDL_Texture    * texture = NULL;
-    SDL_Rect         pos;
-    SDL_Color        fg_sdl_color, bg_sdl_color;
-    uint32_t         fg_rgba, bg_rgba;
-
-    // init 
-    fg_rgba = sdl_color_to_rgba[fg_color];
-    fg_sdl_color.r = (fg_rgba >> 24) & 0xff;
-    fg_sdl_color.g = (fg_rgba >> 16) & 0xff;
-    fg_sdl_color.b = (fg_rgba >>  8) & 0xff;
-    fg_sdl_color.a = (fg_rgba >>  0) & 0xff;
-
-    bg_rgba = sdl_color_to_rgba[bg_color];
-    bg_sdl_color.r = (bg_rgba >> 24) & 0xff;
-    bg_sdl_color.g = (bg_rgba >> 16) & 0xff;
-    bg_sdl_color.b = (bg_rgba >>  8) & 0xff;
-    bg_sdl_color.a = (bg_rgba >>  0) & 0xff;
+    SDL_Texture      * texture = NULL;
+    sdl_text_cache_t * tc = NULL;
+    SDL_Rect           pos;
+    bool               underline = (event_id != SDL_EVENT_NONE);
 
     // if zero length string then nothing to do
     if (str[0] == '\0') {
         return;
     }
 
-    // render the text to a surface
-    if (event_id == SDL_EVENT_NONE) {
-        surface = TTF_RenderText_Shaded(sdl_font[font_id].font, str, fg_sdl_color, bg_sdl_color);
+    // get the texture for the text; short strings, which are the common case, 
+    // are rendered once and then reused from the text cache; long strings
+    // are rendered to a temporary texture
+    if (strlen(str) < MAX_TEXT_CACHE_STR) {
+        tc = sdl_text_cache_get(font_id, underline, fg_color, bg_color, str);
+        if (tc == NULL) {
+            return;
+        }
+        texture = tc->texture;
+        pos.w = tc->w;
+        pos.h = tc->h;
     } else {
-        surface = TTF_RenderText_Shaded(sdl_font[font_id].font_underline, str, fg_sdl_color, bg_sdl_color);
-    }
-    if (surface == NULL) { 
-        ERROR("TTF_RenderText_Shaded returned NULL\n");
-        return;
+        texture = sdl_text_to_texture(underline ? sdl_font[font_id].font_underline : sdl_font[font_id].font,
+                                      fg_color, bg_color, str);
+        if (texture == NULL) {
+            return;
+        }
+        SDL_QueryTexture(texture, NULL, NULL, &pos.w, &pos.h);
     }
 
     // determine the display location
@@ -900,22 +1088,13 @@ void sdl_render_text_with_event(rect_t * pane, int32_t row, int32_t col, int32_t
     if (row < 0) {
         pos.y += pane->h;
     }
-    pos.w = surface->w;
-    pos.h = surface->h;
 
-    // create texture from the surface, and 
     // render the texture
-    texture = SDL_CreateTextureFromSurface(sdl_renderer, surface); 
     SDL_RenderCopy(sdl_renderer, texture, NULL, &pos); 
 
     // clean up
-    if (surface) {
-        SDL_FreeSurface(surface); 
-        surface = NULL;
-    }
-    if (texture) {
+    if (tc == NULL) {
         SDL_DestroyTexture(texture); 
-        texture = NULL;
     }
 
     // if there is a event then save the location for the event handler
@@ -931,6 +1110,169 @@ void sdl_render_text_with_event(rect_t * pane, int32_t row, int32_t col, int32_t
     }
 }
 
+static SDL_Texture * sdl_text_to_texture(TTF_Font * font, int32_t fg_color, int32_t bg_color, char * str)
+{
+    SDL_Surface * surface;
+    SDL_Texture * texture;
+    uint32_t      fg_rgba;
+    uint32_t      bg_rgba;
+    SDL_Color     fg_sdl_color;
+    SDL_Color     bg_sdl_color;
+
+    fg_rgba = sdl_color_to_rgba[fg_color];
+    fg_sdl_color.r = (fg_rgba >> 24) & 0xff;
+    fg_sdl_color.g = (fg_rgba >> 16) & 0xff;
+    fg_sdl_color.b = (fg_rgba >>  8) & 0xff;
+    fg_sdl_color.a = (fg_rgba >>  0) & 0xff;
+
+    bg_rgba = sdl_color_to_rgba[bg_color];
+    bg_sdl_color.r = (bg_rgba >> 24) & 0xff;
+    bg_sdl_color.g = (bg_rgba >> 16) & 0xff;
+    bg_sdl_color.b = (bg_rgba >>  8) & 0xff;
+    bg_sdl_color.a = (bg_rgba >>  0) & 0xff;
+
+    surface = TTF_RenderText_Shaded(font, str, fg_sdl_color, bg_sdl_color);
+    if (surface == NULL) {
+        ERROR("TTF_RenderText_Shaded returned NULL\n");
+        return NULL;
+    }
+    texture = SDL_CreateTextureFromSurface(sdl_renderer, surface);
+    if (texture == NULL) {
+        ERROR("failed to allocate texture\n");
+    }
+    SDL_FreeSurface(surface);
+
+    return texture;
+}
+
+// -----------------  TEXT CACHE  ---------------------------------------
+
+// The text cache holds the textures of recently rendered strings, keyed by
+// font, underline, colors and string. This avoids the TTF render, surface to 
+// texture upload, and texture destroy for strings that are rendered on 
+// every frame. The entries are found using a hash table, and when the cache 
+// is full the least recently used entry is reused.
+
+static void sdl_text_cache_reset(void)
+{
+    int32_t i;
+
+    for (i = 0; i < sdl_max_text_cache; i++) {
+        SDL_DestroyTexture(sdl_text_cache[i].texture);
+    }
+    sdl_max_text_cache = 0;
+    sdl_text_cache_lru_head = -1;
+    sdl_text_cache_lru_tail = -1;
+    for (i = 0; i < MAX_TEXT_CACHE_HASH; i++) {
+        sdl_text_cache_hash_head[i] = -1;
+    }
+}
+
+static void sdl_text_cache_lru_remove(int32_t idx)
+{
+    sdl_text_cache_t * tc = &sdl_text_cache[idx];
+
+    if (tc->lru_prev != -1) {
+        sdl_text_cache[tc->lru_prev].lru_next = tc->lru_next;
+    } else {
+        sdl_text_cache_lru_head = tc->lru_next;
+    }
+    if (tc->lru_next != -1) {
+        sdl_text_cache[tc->lru_next].lru_prev = tc->lru_prev;
+    } else {
+        sdl_text_cache_lru_tail = tc->lru_prev;
+    }
+}
+
+static void sdl_text_cache_lru_insert(int32_t idx)
+{
+    sdl_text_cache_t * tc = &sdl_text_cache[idx];
+
+    tc->lru_prev = -1;
+    tc->lru_next = sdl_text_cache_lru_head;
+    if (sdl_text_cache_lru_head != -1) {
+        sdl_text_cache[sdl_text_cache_lru_head].lru_prev = idx;
+    } else {
+        sdl_text_cache_lru_tail = idx;
+    }
+    sdl_text_cache_lru_head = idx;
+}
+
+static void sdl_text_cache_hash_remove(int32_t idx)
+{
+    int32_t * p = &sdl_text_cache_hash_head[sdl_text_cache[idx].hash & (MAX_TEXT_CACHE_HASH-1)];
+
+    while (*p != idx) {
+        p = &sdl_text_cache[*p].hash_next;
+    }
+    *p = sdl_text_cache[idx].hash_next;
+}
+
+static sdl_text_cache_t * sdl_text_cache_get(int32_t font_id, bool underline, int32_t fg_color, 
+                                             int32_t bg_color, char * str)
+{
+    uint32_t           hash;
+    int32_t            idx;
+    char             * p;
+    sdl_text_cache_t * tc;
+    SDL_Texture      * texture;
+
+    // FNV-1a hash of the key
+    hash = 2166136261u;
+    hash = (hash ^ (font_id | (underline << 8) | (fg_color << 16) | (bg_color << 24))) * 16777619u;
+    for (p = str; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+
+    // if found then move the entry to the head of the lru list, and return it
+    for (idx = sdl_text_cache_hash_head[hash & (MAX_TEXT_CACHE_HASH-1)]; idx != -1; idx = tc->hash_next) {
+        tc = &sdl_text_cache[idx];
+        if (tc->hash == hash && tc->font_id == font_id && tc->underline == underline &&
+            tc->fg_color == fg_color && tc->bg_color == bg_color && strcmp(tc->str, str) == 0)
+        {
+            if (idx != sdl_text_cache_lru_head) {
+                sdl_text_cache_lru_remove(idx);
+                sdl_text_cache_lru_insert(idx);
+            }
+            return tc;
+        }
+    }
+
+    // not found, render the text
+    texture = sdl_text_to_texture(underline ? sdl_font[font_id].font_underline : sdl_font[font_id].font,
+                                  fg_color, bg_color, str);
+    if (texture == NULL) {
+        return NULL;
+    }
+
+    // use an unused entry, or if there are none then reuse the least recently used entry
+    if (sdl_max_text_cache < MAX_TEXT_CACHE) {
+        idx = sdl_max_text_cache++;
+    } else {
+        idx = sdl_text_cache_lru_tail;
+        sdl_text_cache_lru_remove(idx);
+        sdl_text_cache_hash_remove(idx);
+        SDL_DestroyTexture(sdl_text_cache[idx].texture);
+    }
+
+    // init the entry, and add it to the hash table and lru list
+    tc = &sdl_text_cache[idx];
+    tc->texture   = texture;
+    tc->font_id   = font_id;
+    tc->fg_color  = fg_color;
+    tc->bg_color  = bg_color;
+    tc->underline = underline;
+    tc->hash      = hash;
+    strcpy(tc->str, str);
+    SDL_QueryTexture(texture, NULL, NULL, &tc->w, &tc->h);
+
+    tc->hash_next = sdl_text_cache_hash_head[hash & (MAX_TEXT_CACHE_HASH-1)];
+    sdl_text_cache_hash_head[hash & (MAX_TEXT_CACHE_HASH-1)] = idx;
+    sdl_text_cache_lru_insert(idx);
+
+    return tc;
+}
+
 // -----------------  RENDER RECTANGLES & LINES  ------------------------ 
 
 void sdl_render_rect(rect_t * pane, rect_t * rect_arg, int32_t line_width, int32_t color)
@@ -1004,6 +1346,13 @@ void sdl_render_lines(rect_t * pane, point_t * points, int32_t count, int32_t co
     }
 }
 
+// return the red, green, blue and alpha of the color, from the most to the 
+// least significant byte
+uint32_t sdl_color_rgba(int32_t color)
+{
+    return sdl_color_to_rgba[color];
+}
+
 static void sdl_set_color(int32_t color)
 {
     uint8_t r, g, b, a;
@@ -1035,6 +1384,63 @@ texture_t sdl_create_texture(int32_t w, int32_t h)
     return (texture_t)texture;
 }
 
+// create a texture that can be used as a render target, see sdl_set_render_target;
+// note that the contents of render target textures are lost on some platforms, 
+// such as when the window is resized, in which case SDL_EVENT_RENDER_TARGETS_RESET
+// is returned by sdl_poll_event
+texture_t sdl_create_target_texture(int32_t w, int32_t h)
+{
+    SDL_Texture * texture;
+
+    texture = SDL_CreateTexture(sdl_renderer,
+                                SDL_PIXELFORMAT_ABGR8888,
+                                SDL_TEXTUREACCESS_TARGET,
+                                w, h);
+    if (texture == NULL) {
+        ERROR("failed to allocate target texture, %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    return (texture_t)texture;
+}
+
+// set the texture that subsequent rendering is done to; 
+// a NULL texture selects the window
+void sdl_set_render_target(texture_t texture)
+{
+    if (SDL_SetRenderTarget(sdl_renderer, (SDL_Texture *)texture) != 0) {
+        ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+    }
+}
+
+// create a w by h render target texture, and render the srcrect portion of the
+// src texture, scaled, to it; srcrect NULL selects the entire src texture; the new 
+// texture is created without reading the pixels back from the gpu; the render 
+// target in use when this is called is restored
+texture_t sdl_create_scaled_texture(texture_t src, frect_t * srcrect, int32_t w, int32_t h)
+{
+    SDL_Texture * texture, * prior_target;
+    SDL_Rect      dstrect = { 0, 0, w, h };
+
+    texture = sdl_create_target_texture(w, h);
+    if (texture == NULL) {
+        return NULL;
+    }
+
+    prior_target = SDL_GetRenderTarget(sdl_renderer);
+    if (SDL_SetRenderTarget(sdl_renderer, texture) != 0) {
+        ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+        SDL_DestroyTexture(texture);
+        return NULL;
+    }
+    SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(sdl_renderer);
+    sdl_render_copy_subpixel((SDL_Texture *)src, srcrect, &dstrect);
+    SDL_SetRenderTarget(sdl_renderer, prior_target);
+
+    return (texture_t)texture;
+}
+
 texture_t sdl_create_texture_from_pane_pixels(rect_t * pane_arg)
 {
     texture_t texture;
@@ -1132,43 +1538,11 @@ texture_t sdl_create_filled_circle_texture(int32_t radius, int32_t color)
 
 texture_t sdl_create_text_texture(int32_t fg_color, int32_t bg_color, int32_t font_id, char * str)
 {
-    SDL_Surface * surface;
-    SDL_Texture * texture;
-    uint32_t      fg_rgba;
-    uint32_t      bg_rgba;
-    SDL_Color     fg_sdl_color;
-    SDL_Color     bg_sdl_color;
-
     if (str[0] == '\0') {
         return NULL;
     }
 
-    fg_rgba = sdl_color_to_rgba[fg_color];
-    fg_sdl_color.r = (fg_rgba >> 24) & 0xff;
-    fg_sdl_color.g = (fg_rgba >> 16) & 0xff;
-    fg_sdl_color.b = (fg_rgba >>  8) & 0xff;
-    fg_sdl_color.a = (fg_rgba >>  0) & 0xff;
-
-    bg_rgba = sdl_color_to_rgba[bg_color];
-    bg_sdl_color.r = (bg_rgba >> 24) & 0xff;
-    bg_sdl_color.g = (bg_rgba >> 16) & 0xff;
-    bg_sdl_color.b = (bg_rgba >>  8) & 0xff;
-    bg_sdl_color.a = (bg_rgba >>  0) & 0xff;
-
-    surface = TTF_RenderText_Shaded(sdl_font[font_id].font, str, fg_sdl_color, bg_sdl_color);
-    if (surface == NULL) {
-        ERROR("failed to allocate surface\n");
-        return NULL;
-    }
-    texture = SDL_CreateTextureFromSurface(sdl_renderer, surface);
-    if (texture == NULL) {
-        ERROR("failed to allocate texture\n");
-        SDL_FreeSurface(surface);
-        return NULL;
-    }
-    SDL_FreeSurface(surface);
-
-    return (texture_t)texture;
+    return (texture_t)sdl_text_to_texture(sdl_font[font_id].font, fg_color, bg_color, str);
 }
 
 void sdl_update_texture(texture_t texture, uint8_t * pixels, int32_t pitch) 
@@ -1210,9 +1584,419 @@ void sdl_render_texture(texture_t texture, rect_t * dstrect_arg)
     SDL_RenderCopy(sdl_renderer, texture, NULL, &dstrect);
 }
 
+// render the srcrect portion of the texture to dstrect; this allows a portion 
+// of a texture, such as a crop area, to be displayed without creating a new texture
+void sdl_render_texture_src(texture_t texture, frect_t * srcrect, rect_t * dstrect_arg)
+{
+    SDL_Rect dstrect;
+
+    if (texture == NULL) {
+        return;
+    }
+
+    dstrect.x = dstrect_arg->x;
+    dstrect.y = dstrect_arg->y;
+    dstrect.w = dstrect_arg->w;
+    dstrect.h = dstrect_arg->h;
+
+    sdl_render_copy_subpixel((SDL_Texture *)texture, srcrect, &dstrect);
+}
+
+// render the srcrect portion of the src texture, scaled, to dstrect; srcrect NULL 
+// selects the entire src texture; SDL_RenderCopy takes an integer source rectangle, 
+// so a srcrect with a fractional position or size is honored by rendering the 
+// enclosing whole source pixels to a correspondingly larger destination, at a subpixel 
+// position, and clipping that to dstrect
+static void sdl_render_copy_subpixel(SDL_Texture * src, frect_t * srcrect, SDL_Rect * dstrect)
+{
+    SDL_Rect isrc;
+    double   x0, y0, x1, y1;
+
+    if (srcrect == NULL) {
+        SDL_RenderCopy(sdl_renderer, src, NULL, dstrect);
+        return;
+    }
+
+    x0 = floor(srcrect->x);
+    y0 = floor(srcrect->y);
+    x1 = ceil(srcrect->x + srcrect->w);
+    y1 = ceil(srcrect->y + srcrect->h);
+    isrc.x = x0;
+    isrc.y = y0;
+    isrc.w = x1 - x0;
+    isrc.h = y1 - y0;
+
+#if SDL_VERSION_ATLEAST(2,0,10)
+    if (srcrect->w > 0 && srcrect->h > 0 &&
+        (x0 != srcrect->x || y0 != srcrect->y || isrc.w != srcrect->w || isrc.h != srcrect->h))
+    {
+        SDL_FRect fdst;
+        double    scale_x, scale_y;
+
+        scale_x = dstrect->w / srcrect->w;
+        scale_y = dstrect->h / srcrect->h;
+        fdst.x = dstrect->x - (srcrect->x - x0) * scale_x;
+        fdst.y = dstrect->y - (srcrect->y - y0) * scale_y;
+        fdst.w = isrc.w * scale_x;
+        fdst.h = isrc.h * scale_y;
+
+        SDL_RenderSetClipRect(sdl_renderer, dstrect);
+        SDL_RenderCopyF(sdl_renderer, src, &isrc, &fdst);
+        SDL_RenderSetClipRect(sdl_renderer, NULL);
+        return;
+    }
+#else
+    // without SDL_RenderCopyF, the source rectangle is rounded to whole pixels
+    isrc.x = nearbyint(srcrect->x);
+    isrc.y = nearbyint(srcrect->y);
+    isrc.w = nearbyint(srcrect->x + srcrect->w) - isrc.x;
+    isrc.h = nearbyint(srcrect->y + srcrect->h) - isrc.y;
+#endif
+
+    SDL_RenderCopy(sdl_renderer, src, &isrc, dstrect);
+}
+
 void sdl_destroy_texture(texture_t texture)
 {
     if (texture) {
         SDL_DestroyTexture((SDL_Texture *)texture);
     }
 }
+
+// -----------------  TEXTURE ATLAS  ------------------------------------
+
+// The atlas packs many small render target textures, such as the cached
+// pane textures, into a few large atlas textures. This allows the slots 
+// that are in the same atlas texture to be rendered together, by 
+// sdl_atlas_render_flush, using a single SDL_RenderGeometry call.
+//
+// Slots are allocated using a shelf packer: each atlas texture is divided
+// into horizontal shelves, and a slot is placed at the end of the first shelf
+// that is tall enough and has room; if there is no such shelf then a new shelf
+// is started below the last. Freed slots are saved on a free list, and are
+// reused by a subsequent allocation of the same size; this is the common case
+// because the panes are usually all the same size.
+
+static void sdl_atlas_render_quad(sdl_atlas_t * a, rect_t * src, rect_t * dst);
+
+int32_t sdl_atlas_alloc(int32_t w, int32_t h, atlas_slot_t * slot)
+{
+    sdl_atlas_t * a;
+    int32_t i, j;
+
+    slot->atlas = -1;
+    if (w <= 0 || h <= 0 || w > sdl_atlas_dim || h > sdl_atlas_dim) {
+        return -1;
+    }
+
+    // reuse a free slot of the same size
+    for (i = sdl_max_atlas_free_slot-1; i >= 0; i--) {
+        if (sdl_atlas_free_slot[i].rect.w == w && sdl_atlas_free_slot[i].rect.h == h) {
+            *slot = sdl_atlas_free_slot[i];
+            sdl_atlas_free_slot[i] = sdl_atlas_free_slot[--sdl_max_atlas_free_slot];
+            return 0;
+        }
+    }
+
+    // search the shelves of the existing atlas textures for a shelf that is 
+    // tall enough, but not too tall, and has room 
+    for (i = 0; i < sdl_max_atlas; i++) {
+        a = &sdl_atlas[i];
+        for (j = 0; j < a->max_shelf; j++) {
+            sdl_atlas_shelf_t * shelf = &a->shelf[j];
+            if (shelf->h >= h && shelf->h <= h + h / 4 && shelf->x_used + w <= sdl_atlas_dim) {
+                goto found;
+            }
+        }
+        if (a->y_used + h <= sdl_atlas_dim) {
+            goto new_shelf;
+        }
+    }
+
+    // create a new atlas texture
+    a = realloc(sdl_atlas, (sdl_max_atlas+1) * sizeof(sdl_atlas_t));
+    if (a == NULL) {
+        ERROR("allocate atlas failed\n");
+        return -1;
+    }
+    sdl_atlas = a;
+    a = &sdl_atlas[sdl_max_atlas];
+    bzero(a, sizeof(sdl_atlas_t));
+    a->texture = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET, 
+                                   sdl_atlas_dim, sdl_atlas_dim);
+    if (a->texture == NULL) {
+        ERROR("failed to allocate atlas texture %d, %s\n", sdl_max_atlas, SDL_GetError());
+        return -1;
+    }
+    i = sdl_max_atlas++;
+    DEBUG("created atlas texture %d, %dx%d\n", i, sdl_atlas_dim, sdl_atlas_dim);
+
+new_shelf:
+    // start a new shelf in atlas i
+    a = &sdl_atlas[i];
+    if ((a->max_shelf % 64) == 0) {
+        sdl_atlas_shelf_t * shelf = realloc(a->shelf, (a->max_shelf + 64) * sizeof(sdl_atlas_shelf_t));
+        if (shelf == NULL) {
+            ERROR("allocate atlas shelf failed\n");
+            return -1;
+        }
+        a->shelf = shelf;
+    }
+    j = a->max_shelf++;
+    a->shelf[j].y = a->y_used;
+    a->shelf[j].h = h;
+    a->shelf[j].x_used = 0;
+    a->y_used += h;
+
+found:
+    // allocate the slot at the end of shelf j of atlas i
+    slot->atlas  = i;
+    slot->rect.x = a->shelf[j].x_used;
+    slot->rect.y = a->shelf[j].y;
+    slot->rect.w = w;
+    slot->rect.h = h;
+    a->shelf[j].x_used += w;
+    return 0;
+}
+
+void sdl_atlas_free(atlas_slot_t * slot)
+{
+    atlas_slot_t * free_slot;
+
+    if (slot->atlas == -1) {
+        return;
+    }
+
+    if ((sdl_max_atlas_free_slot % 256) == 0) {
+        free_slot = realloc(sdl_atlas_free_slot, (sdl_max_atlas_free_slot + 256) * sizeof(atlas_slot_t));
+        if (free_slot == NULL) {
+            ERROR("allocate atlas free slot failed\n");
+            slot->atlas = -1;
+            return;
+        }
+        sdl_atlas_free_slot = free_slot;
+    }
+    sdl_atlas_free_slot[sdl_max_atlas_free_slot++] = *slot;
+    slot->atlas = -1;
+}
+
+// free all slots; the atlas textures are retained for reuse
+void sdl_atlas_reset(void)
+{
+    int32_t i;
+
+    for (i = 0; i < sdl_max_atlas; i++) {
+        sdl_atlas[i].max_shelf = 0;
+        sdl_atlas[i].y_used = 0;
+        sdl_atlas[i].max_quad = 0;
+    }
+    sdl_max_atlas_free_slot = 0;
+}
+
+// render the srcrect portion of the src texture, scaled, to the slot; srcrect NULL
+// selects the entire src texture; the render target in use when this is called is restored
+void sdl_atlas_update(atlas_slot_t * slot, texture_t src, frect_t * srcrect)
+{
+    SDL_Texture * prior_target;
+    SDL_Rect dstrect;
+
+    if (slot->atlas == -1) {
+        return;
+    }
+
+    dstrect.x = slot->rect.x;
+    dstrect.y = slot->rect.y;
+    dstrect.w = slot->rect.w;
+    dstrect.h = slot->rect.h;
+
+    prior_target = SDL_GetRenderTarget(sdl_renderer);
+    if (SDL_SetRenderTarget(sdl_renderer, sdl_atlas[slot->atlas].texture) != 0) {
+        ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+        return;
+    }
+    SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderFillRect(sdl_renderer, &dstrect);
+    sdl_render_copy_subpixel((SDL_Texture *)src, srcrect, &dstrect);
+    SDL_SetRenderTarget(sdl_renderer, prior_target);
+}
+
+// copy the pixels, which are the size of the slot, to the slot; pitch is in pixels
+void sdl_atlas_update_pixels(atlas_slot_t * slot, uint8_t * pixels, int32_t pitch)
+{
+    SDL_Rect rect;
+
+    if (slot->atlas == -1) {
+        return;
+    }
+
+    rect.x = slot->rect.x;
+    rect.y = slot->rect.y;
+    rect.w = slot->rect.w;
+    rect.h = slot->rect.h;
+    if (SDL_UpdateTexture(sdl_atlas[slot->atlas].texture, &rect, pixels, pitch*BYTES_PER_PIXEL) != 0) {
+        ERROR("SDL_UpdateTexture failed, %s\n", SDL_GetError());
+    }
+}
+
+// render the src_slot, scaled, to the slot; this is used to create mip levels;
+// when both slots are in the same atlas texture, src_slot is first copied to 
+// a scratch texture, because a texture can not be rendered to itself
+void sdl_atlas_update_from_slot(atlas_slot_t * slot, atlas_slot_t * src_slot)
+{
+    static SDL_Texture * scratch;
+    static int32_t       scratch_w, scratch_h;
+
+    SDL_Texture * prior_target, * src_texture;
+    SDL_Rect      srcrect, dstrect;
+
+    if (slot->atlas == -1 || src_slot->atlas == -1) {
+        return;
+    }
+
+    srcrect.x = src_slot->rect.x;
+    srcrect.y = src_slot->rect.y;
+    srcrect.w = src_slot->rect.w;
+    srcrect.h = src_slot->rect.h;
+    dstrect.x = slot->rect.x;
+    dstrect.y = slot->rect.y;
+    dstrect.w = slot->rect.w;
+    dstrect.h = slot->rect.h;
+    src_texture = sdl_atlas[src_slot->atlas].texture;
+
+    prior_target = SDL_GetRenderTarget(sdl_renderer);
+
+    if (slot->atlas == src_slot->atlas) {
+        SDL_Rect scratch_rect = { 0, 0, srcrect.w, srcrect.h };
+
+        if (scratch == NULL || scratch_w < srcrect.w || scratch_h < srcrect.h) {
+            if (scratch) {
+                SDL_DestroyTexture(scratch);
+            }
+            scratch_w = max(scratch_w, srcrect.w);
+            scratch_h = max(scratch_h, srcrect.h);
+            scratch = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET, 
+                                        scratch_w, scratch_h);
+            if (scratch == NULL) {
+                ERROR("failed to allocate atlas scratch texture, %s\n", SDL_GetError());
+                scratch_w = scratch_h = 0;
+                return;
+            }
+        }
+        if (SDL_SetRenderTarget(sdl_renderer, scratch) != 0) {
+            ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+            return;
+        }
+        SDL_RenderCopy(sdl_renderer, src_texture, &srcrect, &scratch_rect);
+        src_texture = scratch;
+        srcrect = scratch_rect;
+    }
+
+    if (SDL_SetRenderTarget(sdl_renderer, sdl_atlas[slot->atlas].texture) != 0) {
+        ERROR("SDL_SetRenderTarget failed, %s\n", SDL_GetError());
+        SDL_SetRenderTarget(sdl_renderer, prior_target);
+        return;
+    }
+    SDL_RenderCopy(sdl_renderer, src_texture, &srcrect, &dstrect);
+    SDL_SetRenderTarget(sdl_renderer, prior_target);
+}
+
+// queue the slot to be rendered at dstrect, the queued slots are 
+// rendered by sdl_atlas_render_flush
+void sdl_atlas_render(atlas_slot_t * slot, rect_t * dstrect)
+{
+    if (slot->atlas == -1) {
+        return;
+    }
+    sdl_atlas_render_quad(&sdl_atlas[slot->atlas], &slot->rect, dstrect);
+}
+
+// render the queued slots, using one SDL_RenderGeometry call per atlas texture;
+// when SDL is older than 2.0.18, which does not have SDL_RenderGeometry, 
+// SDL_RenderCopy is used for each slot
+void sdl_atlas_render_flush(void)
+{
+    int32_t i;
+
+    for (i = 0; i < sdl_max_atlas; i++) {
+        sdl_atlas_t * a = &sdl_atlas[i];
+        if (a->max_quad == 0) {
+            continue;
+        }
+#if SDL_VERSION_ATLEAST(2,0,18)
+        if (SDL_RenderGeometry(sdl_renderer, a->texture, a->vertex, 4 * a->max_quad, 
+                               a->index, 6 * a->max_quad) != 0) 
+        {
+            ERROR("SDL_RenderGeometry failed, %s\n", SDL_GetError());
+        }
+#else
+        int32_t j;
+        for (j = 0; j < a->max_quad; j++) {
+            SDL_RenderCopy(sdl_renderer, a->texture, &a->quad_src[j], &a->quad_dst[j]);
+        }
+#endif
+        a->max_quad = 0;
+    }
+}
+
+static void sdl_atlas_render_quad(sdl_atlas_t * a, rect_t * src, rect_t * dst)
+{
+    int32_t n = a->max_quad;
+
+    // if needed, expand the quad arrays
+    if (n == a->alloc_quad) {
+        int32_t alloc_quad = (a->alloc_quad == 0 ? 256 : 2 * a->alloc_quad);
+#if SDL_VERSION_ATLEAST(2,0,18)
+        SDL_Vertex * vertex = realloc(a->vertex, 4 * alloc_quad * sizeof(SDL_Vertex));
+        int        * index  = realloc(a->index, 6 * alloc_quad * sizeof(int));
+        if (vertex) a->vertex = vertex;
+        if (index)  a->index  = index;
+        if (vertex == NULL || index == NULL) {
+            ERROR("allocate atlas quads failed\n");
+            return;
+        }
+#else
+        SDL_Rect * quad_src = realloc(a->quad_src, alloc_quad * sizeof(SDL_Rect));
+        SDL_Rect * quad_dst = realloc(a->quad_dst, alloc_quad * sizeof(SDL_Rect));
+        if (quad_src) a->quad_src = quad_src;
+        if (quad_dst) a->quad_dst = quad_dst;
+        if (quad_src == NULL || quad_dst == NULL) {
+            ERROR("allocate atlas quads failed\n");
+            return;
+        }
+#endif
+        a->alloc_quad = alloc_quad;
+    }
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+    {
+    // add the 4 corners of the quad, and the 2 triangles that make up the quad
+    static const SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Vertex * v   = &a->vertex[4*n];
+    int        * idx = &a->index[6*n];
+    float        tx0 = (float)src->x / sdl_atlas_dim;
+    float        ty0 = (float)src->y / sdl_atlas_dim;
+    float        tx1 = (float)(src->x + src->w) / sdl_atlas_dim;
+    float        ty1 = (float)(src->y + src->h) / sdl_atlas_dim;
+
+    v[0].position.x = dst->x;          v[0].position.y = dst->y;
+    v[1].position.x = dst->x + dst->w; v[1].position.y = dst->y;
+    v[2].position.x = dst->x + dst->w; v[2].position.y = dst->y + dst->h;
+    v[3].position.x = dst->x;          v[3].position.y = dst->y + dst->h;
+    v[0].tex_coord.x = tx0;            v[0].tex_coord.y = ty0;
+    v[1].tex_coord.x = tx1;            v[1].tex_coord.y = ty0;
+    v[2].tex_coord.x = tx1;            v[2].tex_coord.y = ty1;
+    v[3].tex_coord.x = tx0;            v[3].tex_coord.y = ty1;
+    v[0].color = v[1].color = v[2].color = v[3].color = white;
+
+    idx[0] = 4*n+0; idx[1] = 4*n+1; idx[2] = 4*n+2;
+    idx[3] = 4*n+0; idx[4] = 4*n+2; idx[5] = 4*n+3;
+    }
+#else
+    a->quad_src[n].x = src->x;  a->quad_src[n].y = src->y;
+    a->quad_src[n].w = src->w;  a->quad_src[n].h = src->h;
+    a->quad_dst[n].x = dst->x;  a->quad_dst[n].y = dst->y;
+    a->quad_dst[n].w = dst->w;  a->quad_dst[n].h = dst->h;
+#endif
+
+    a->max_quad++;
+}
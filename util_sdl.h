@@ -66,6 +66,9 @@ SOFTWARE.
 #define SDL_EVENT_WIN_RESTORED           162
 // - screenshot
 #define SDL_EVENT_SCREENSHOT_TAKEN       170
+#define SDL_EVENT_FLASH_DONE             171
+// - render target textures contents lost
+#define SDL_EVENT_RENDER_TARGETS_RESET   175
 // - quit
 #define SDL_EVENT_QUIT                   180
 // - available to be defined by users
@@ -131,14 +134,25 @@ typedef struct {
 typedef void * texture_t;
 
 typedef struct {
-    int16_t x, y;
-    int16_t w, h;
+    int32_t x, y;
+    int32_t w, h;
 } rect_t;
 
+// a rectangle with subpixel position and size, used for source rectangles
+typedef struct {
+    double x, y;
+    double w, h;
+} frect_t;
+
 typedef struct {
     int32_t x, y;
 } point_t;
 
+typedef struct {
+    int32_t atlas;   // -1 if not allocated
+    rect_t  rect;    // location in the atlas texture
+} atlas_slot_t;
+
 //
 // prototypes
 //
@@ -152,7 +166,7 @@ void sdl_display_init(void);
 void sdl_display_present(void);
 
 // pane support
-void sdl_init_pane(rect_t * pane, rect_t * rect, int16_t x, int16_t y, int16_t w, int16_t h);
+void sdl_init_pane(rect_t * pane, rect_t * rect, int32_t x, int32_t y, int32_t w, int32_t h);
 int32_t sdl_pane_cols(rect_t * rect, int32_t fid);
 int32_t sdl_pane_rows(rect_t * rect, int32_t fid);
 void sdl_render_pane_border(rect_t * pane_full, int32_t color);
@@ -164,6 +178,8 @@ int32_t sdl_font_char_height(int32_t fid);
 // event support
 void sdl_event_register(int32_t event_id, int32_t event_type, rect_t * pos);
 sdl_event_t * sdl_poll_event(void);
+sdl_event_t * sdl_wait_event(int32_t timeout_ms);
+void sdl_push_user_event(int32_t event_id);
 void sdl_play_event_sound(void);
 
 // render text
@@ -177,18 +193,33 @@ void sdl_render_rect(rect_t * pane, rect_t * rect, int32_t line_width, int32_t c
 void sdl_render_fill_rect(rect_t * pane, rect_t * rect, int32_t color);
 void sdl_render_line(rect_t * pane, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t color);
 void sdl_render_lines(rect_t * pane, point_t * points, int32_t count, int32_t color);
+uint32_t sdl_color_rgba(int32_t color);
 
 // render using textures
 texture_t sdl_create_texture(int32_t w, int32_t h);
+texture_t sdl_create_target_texture(int32_t w, int32_t h);
+void sdl_set_render_target(texture_t texture);
+texture_t sdl_create_scaled_texture(texture_t src, frect_t * srcrect, int32_t w, int32_t h);
 texture_t sdl_create_filled_circle_texture(int32_t radius, int32_t color);
 texture_t sdl_create_text_texture(int32_t fg_color, int32_t bg_color, int32_t font_id, char * str);
 void sdl_update_texture(texture_t texture, uint8_t * pixels, int32_t pitch);
 void sdl_query_texture(texture_t texture, int32_t * width, int32_t * height);
 void sdl_render_texture(texture_t texture, rect_t * dstrect);
+void sdl_render_texture_src(texture_t texture, frect_t * srcrect, rect_t * dstrect);
 void sdl_destroy_texture(texture_t texture);
 
 texture_t sdl_create_texture_from_pane_pixels(rect_t * pane);
 
+// texture atlas, packs many small textures in a few large textures
+int32_t sdl_atlas_alloc(int32_t w, int32_t h, atlas_slot_t * slot);
+void sdl_atlas_free(atlas_slot_t * slot);
+void sdl_atlas_reset(void);
+void sdl_atlas_update(atlas_slot_t * slot, texture_t src, frect_t * srcrect);
+void sdl_atlas_update_pixels(atlas_slot_t * slot, uint8_t * pixels, int32_t pitch);
+void sdl_atlas_update_from_slot(atlas_slot_t * slot, atlas_slot_t * src_slot);
+void sdl_atlas_render(atlas_slot_t * slot, rect_t * dstrect);
+void sdl_atlas_render_flush(void);
+
 // predefined displays
 void sdl_display_get_string(int32_t count, ...);
 void sdl_display_text(char * text);
@@ -197,5 +228,8 @@ void sdl_display_error(char * err_str0, char * err_str1, char * err_str2);
 
 // print screen, file_name must end in .jpg or .png
 void sdl_print_screen(char * file_name, bool flash_display, rect_t * rect);
+void sdl_print_texture(char * file_name, bool flash_display, texture_t texture, rect_t * rect,
+                       uint8_t * icc_profile, int32_t icc_profile_len);
+void sdl_flash_display(void);
 
 #endif
@@ -0,0 +1,437 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "util_stats.h"
+#include "util_misc.h"
+
+//
+// notes:
+// - each thread that records a span gets its own span buffer, the buffer is
+//   a linked list of chunks; only the owning thread appends to its buffer so
+//   recording a span does not require a lock
+// - the per-thread buffers are pushed onto stats_thread_list using an atomic
+//   compare-and-swap, and are never freed
+// - the reports are expected to be generated after the work being measured
+//   has completed; the chunk count is stored with release semantics so that
+//   a report generated while other threads are still recording will see only
+//   completely written spans
+//
+
+//
+// defines
+//
+
+#define STATS_CHUNK_SPANS     4096
+#define MAX_STATS_THREAD_NAME 32
+
+//
+// typedefs
+//
+
+typedef struct {
+    uint64_t start_us;
+    uint64_t end_us;
+    int32_t  stage;
+    int32_t  idx;
+} stats_span_t;
+
+typedef struct stats_chunk_s {
+    struct stats_chunk_s * next;
+    int32_t                count;
+    stats_span_t           span[STATS_CHUNK_SPANS];
+} stats_chunk_t;
+
+typedef struct stats_thread_s {
+    struct stats_thread_s * next;
+    int32_t                 tid;
+    char                    name[MAX_STATS_THREAD_NAME];
+    stats_chunk_t         * first;
+    stats_chunk_t         * last;
+} stats_thread_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t min_us;
+    uint64_t max_us;
+} stats_summary_t;
+
+//
+// variables
+//
+
+bool                    stats_enabled;
+
+static uint64_t         stats_start_us;
+static stats_thread_t * stats_thread_list;
+static __thread stats_thread_t * stats_thread;
+
+//
+// prototypes
+//
+
+static stats_thread_t * stats_thread_register(void);
+static void stats_summarize(stats_summary_t * summary);
+static int64_t stats_peak_rss_kb(void);
+static void stats_json_string(FILE * fp, char * str);
+
+// -----------------  RECORD SPANS  --------------------------------------
+
+void stats_enable(void)
+{
+    if (stats_enabled) {
+        return;
+    }
+    stats_start_us = microsec_timer();
+    stats_enabled = true;
+}
+
+// the thread name is used to label the thread in the trace file
+void stats_set_thread_name(char * name)
+{
+    stats_thread_t * t = stats_thread;
+
+    if (!stats_enabled) {
+        return;
+    }
+    if (t == NULL) {
+        t = stats_thread_register();
+        if (t == NULL) {
+            return;
+        }
+    }
+    snprintf(t->name, sizeof(t->name), "%s", name);
+}
+
+void stats_span_record(int32_t stage, int32_t idx, uint64_t start_us, uint64_t end_us)
+{
+    stats_thread_t * t = stats_thread;
+    stats_chunk_t  * c;
+    stats_span_t   * s;
+
+    // if this thread does not yet have a span buffer then create it
+    if (t == NULL) {
+        t = stats_thread_register();
+        if (t == NULL) {
+            return;
+        }
+    }
+
+    // if the last chunk is full then add another chunk
+    c = t->last;
+    if (c->count == STATS_CHUNK_SPANS) {
+        stats_chunk_t * new_chunk = calloc(1, sizeof(stats_chunk_t));
+        if (new_chunk == NULL) {
+            return;
+        }
+        __atomic_store_n(&c->next, new_chunk, __ATOMIC_RELEASE);
+        t->last = c = new_chunk;
+    }
+
+    // store the span, and then publish it by incrementing the count
+    s = &c->span[c->count];
+    s->start_us = start_us;
+    s->end_us   = end_us;
+    s->stage    = stage;
+    s->idx      = idx;
+    __atomic_store_n(&c->count, c->count+1, __ATOMIC_RELEASE);
+}
+
+static stats_thread_t * stats_thread_register(void)
+{
+    stats_thread_t * t;
+
+    t = calloc(1, sizeof(stats_thread_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->first = t->last = calloc(1, sizeof(stats_chunk_t));
+    if (t->first == NULL) {
+        free(t);
+        return NULL;
+    }
+    t->tid = syscall(SYS_gettid);
+
+    // push onto stats_thread_list
+    t->next = __atomic_load_n(&stats_thread_list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&stats_thread_list, &t->next, t,
+                                        false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        ;
+    }
+
+    stats_thread = t;
+    return t;
+}
+
+// -----------------  REPORTS  -------------------------------------------
+
+// iterate over all of the spans that have been recorded by all threads;
+// the body of this macro is executed with 't' and 's' set
+#define FOR_EACH_SPAN(t, s, body) \
+    do { \
+        stats_thread_t * t; \
+        stats_chunk_t  * _c; \
+        int32_t          _i, _cnt; \
+        for (t = __atomic_load_n(&stats_thread_list, __ATOMIC_ACQUIRE); t; t = t->next) { \
+            for (_c = t->first; _c; _c = __atomic_load_n(&_c->next, __ATOMIC_ACQUIRE)) { \
+                _cnt = __atomic_load_n(&_c->count, __ATOMIC_ACQUIRE); \
+                for (_i = 0; _i < _cnt; _i++) { \
+                    stats_span_t * s = &_c->span[_i]; \
+                    body \
+                } \
+            } \
+        } \
+    } while (0)
+
+void stats_print_summary(void)
+{
+    stats_summary_t summary[MAX_STATS_STAGE];
+    int32_t         stage;
+
+    if (!stats_enabled) {
+        return;
+    }
+
+    stats_summarize(summary);
+
+    printf("%-12s %8s %12s %12s %12s %12s\n",
+           "STAGE", "COUNT", "TOTAL_MS", "MEAN_MS", "MIN_MS", "MAX_MS");
+    for (stage = 0; stage < MAX_STATS_STAGE; stage++) {
+        stats_summary_t * x = &summary[stage];
+        if (x->count == 0) {
+            printf("%-12s %8d %12s %12s %12s %12s\n",
+                   STATS_STAGE_STR(stage), 0, "-", "-", "-", "-");
+            continue;
+        }
+        printf("%-12s %8" PRIu64 " %12.3f %12.3f %12.3f %12.3f\n",
+               STATS_STAGE_STR(stage),
+               x->count,
+               x->total_us / 1000.,
+               (double)x->total_us / x->count / 1000.,
+               x->min_us / 1000.,
+               x->max_us / 1000.);
+    }
+    printf("wall time %.3f ms, peak rss %" PRId64 " KB\n",
+           (microsec_timer() - stats_start_us) / 1000., stats_peak_rss_kb());
+}
+
+int32_t stats_write_json(char * file_name, char ** image_name, int32_t max_image)
+{
+    FILE            * fp;
+    stats_summary_t   summary[MAX_STATS_STAGE];
+    uint64_t        (*image_us)[MAX_STATS_STAGE];
+    int32_t           stage, i;
+
+    if (!stats_enabled) {
+        return 0;
+    }
+
+    // sum the span durations for each image and stage
+    image_us = calloc(max_image > 0 ? max_image : 1, sizeof(*image_us));
+    if (image_us == NULL) {
+        ERROR("allocate image_us failed\n");
+        return -1;
+    }
+    FOR_EACH_SPAN(t, s, {
+        if (s->idx >= 0 && s->idx < max_image) {
+            image_us[s->idx][s->stage] += s->end_us - s->start_us;
+        }
+    });
+    stats_summarize(summary);
+
+    // open file_name
+    fp = fopen(file_name, "w");
+    if (fp == NULL) {
+        ERROR("fopen %s, %s\n", file_name, strerror(errno));
+        free(image_us);
+        return -1;
+    }
+
+    // write the totals
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"wall_us\": %" PRIu64 ",\n", microsec_timer() - stats_start_us);
+    fprintf(fp, "  \"peak_rss_kb\": %" PRId64 ",\n", stats_peak_rss_kb());
+
+    // write the per stage timings
+    fprintf(fp, "  \"stages\": {\n");
+    for (stage = 0; stage < MAX_STATS_STAGE; stage++) {
+        stats_summary_t * x = &summary[stage];
+        fprintf(fp, "    \"%s\": { \"count\": %" PRIu64 ", \"total_us\": %" PRIu64
+                    ", \"min_us\": %" PRIu64 ", \"max_us\": %" PRIu64 " }%s\n",
+                STATS_STAGE_STR(stage), x->count, x->total_us,
+                x->count ? x->min_us : 0, x->max_us,
+                stage < MAX_STATS_STAGE-1 ? "," : "");
+    }
+    fprintf(fp, "  },\n");
+
+    // write the per image timings
+    fprintf(fp, "  \"images\": [\n");
+    for (i = 0; i < max_image; i++) {
+        fprintf(fp, "    { \"idx\": %d, \"file\": ", i);
+        stats_json_string(fp, image_name[i]);
+        for (stage = 0; stage < MAX_STATS_STAGE; stage++) {
+            fprintf(fp, ", \"%s_us\": %" PRIu64, STATS_STAGE_STR(stage), image_us[i][stage]);
+        }
+        fprintf(fp, " }%s\n", i < max_image-1 ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    // close and return
+    free(image_us);
+    if (fclose(fp) != 0) {
+        ERROR("fclose %s, %s\n", file_name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void stats_summarize(stats_summary_t * summary)
+{
+    memset(summary, 0, MAX_STATS_STAGE * sizeof(stats_summary_t));
+    FOR_EACH_SPAN(t, s, {
+        stats_summary_t * x = &summary[s->stage];
+        uint64_t duration = s->end_us - s->start_us;
+        if (x->count == 0 || duration < x->min_us) {
+            x->min_us = duration;
+        }
+        if (duration > x->max_us) {
+            x->max_us = duration;
+        }
+        x->total_us += duration;
+        x->count++;
+    });
+}
+
+//
+// write the spans in chrome trace-event json format, this file can be loaded 
+// by chrome://tracing or https://ui.perfetto.dev
+// - each span is written as a complete event ("ph":"X"), which holds the
+//   span's begin timestamp and its duration
+// - thread names are written as metadata events ("ph":"M")
+// - reference: "Trace Event Format", https://docs.google.com/document/d/
+//   1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+//
+
+int32_t stats_write_trace(char * file_name, char ** image_name, int32_t max_image)
+{
+    FILE           * fp;
+    stats_thread_t * t;
+    int32_t          pid = getpid();
+    bool             first = true;
+
+    if (!stats_enabled) {
+        return 0;
+    }
+
+    // open file_name
+    fp = fopen(file_name, "w");
+    if (fp == NULL) {
+        ERROR("fopen %s, %s\n", file_name, strerror(errno));
+        return -1;
+    }
+
+    // write thread name metadata
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (t = __atomic_load_n(&stats_thread_list, __ATOMIC_ACQUIRE); t; t = t->next) {
+        if (t->name[0] == '\0') {
+            continue;
+        }
+        fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                first ? "" : ",\n", pid, t->tid);
+        stats_json_string(fp, t->name);
+        fprintf(fp, "}}");
+        first = false;
+    }
+
+    // write the spans, timestamps are relative to when stats were enabled
+    FOR_EACH_SPAN(t, s, {
+        fprintf(fp, "%s{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"image_merge\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64,
+                first ? "" : ",\n",
+                STATS_STAGE_STR(s->stage), pid, t->tid,
+                s->start_us - stats_start_us, s->end_us - s->start_us);
+        if (s->idx >= 0 && s->idx < max_image) {
+            fprintf(fp, ",\"args\":{\"image\":%d,\"file\":", s->idx);
+            stats_json_string(fp, image_name[s->idx]);
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "}");
+        first = false;
+    });
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    // close and return
+    if (fclose(fp) != 0) {
+        ERROR("fclose %s, %s\n", file_name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int64_t stats_peak_rss_kb(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;  // linux reports this in kilobytes
+}
+
+static void stats_json_string(FILE * fp, char * str)
+{
+    unsigned char * p;
+
+    if (str == NULL) {
+        fputs("null", fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (p = (unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(fp, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(fp, "\\u%4.4x", *p);
+        } else {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __UTIL_STATS_H__
+#define __UTIL_STATS_H__
+
+// -----------------  STAGES  ------------------------------------
+
+#define STATS_STAGE_STAT       0
+#define STATS_STAGE_PROBE      1
+#define STATS_STAGE_DECODE     2
+#define STATS_STAGE_RESAMPLE   3
+#define STATS_STAGE_COMPOSITE  4
+#define STATS_STAGE_READBACK   5
+#define STATS_STAGE_ENCODE     6
+#define MAX_STATS_STAGE        7
+
+#define STATS_STAGE_STR(x) \
+    ((x) == STATS_STAGE_STAT      ? "stat"      : \
+     (x) == STATS_STAGE_PROBE     ? "probe"     : \
+     (x) == STATS_STAGE_DECODE    ? "decode"    : \
+     (x) == STATS_STAGE_RESAMPLE  ? "resample"  : \
+     (x) == STATS_STAGE_COMPOSITE ? "composite" : \
+     (x) == STATS_STAGE_READBACK  ? "readback"  : \
+     (x) == STATS_STAGE_ENCODE    ? "encode"      \
+                                  : "????")
+
+// -----------------  TIMING SPANS  ------------------------------
+
+// usage:
+//     uint64_t start = STATS_SPAN_BEGIN();
+//     ... work ...
+//     STATS_SPAN_END(STATS_STAGE_DECODE, image_idx, start);
+//
+// when stats are not enabled STATS_SPAN_BEGIN returns 0 and
+// STATS_SPAN_END does nothing; the image_idx arg should be -1 for
+// spans that are not associated with an image
+
+#define STATS_SPAN_BEGIN() \
+    (stats_enabled ? microsec_timer() : 0)
+
+#define STATS_SPAN_END(stage, idx, start) \
+    do { \
+        if (start) { \
+            stats_span_record(stage, idx, start, microsec_timer()); \
+        } \
+    } while (0)
+
+extern bool stats_enabled;
+
+void stats_enable(void);
+void stats_set_thread_name(char * name);
+void stats_span_record(int32_t stage, int32_t idx, uint64_t start_us, uint64_t end_us);
+
+// -----------------  REPORTS  -----------------------------------
+
+void stats_print_summary(void);
+int32_t stats_write_json(char * file_name, char ** image_name, int32_t max_image);
+int32_t stats_write_trace(char * file_name, char ** image_name, int32_t max_image);
+
+#endif
@@ -0,0 +1,467 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "util_sdl.h"
+#include "util_template.h"
+#include "util_misc.h"
+
+//
+// The template is parsed by recursive descent, a line at a time. The region 
+// of each node is known when its line is parsed, so the panes are emitted, 
+// in template order, as the image nodes are parsed; and getting the panes for 
+// a window size is just a scaling of the compiled pane table.
+//
+
+//
+// defines
+//
+
+#define MAX_TEMPLATE_LINE   1000
+#define MAX_TEMPLATE_TOKEN  100
+#define MAX_TEMPLATE_DEPTH  20
+#define MAX_TEMPLATE_CELL   10000
+#define MAX_TEMPLATE_PAD    1000
+
+//
+// typedefs
+//
+
+typedef struct {
+    FILE       * fp;
+    char       * file_name;
+    int32_t      line_num;
+    char         line[MAX_TEMPLATE_LINE];
+    char       * token[MAX_TEMPLATE_TOKEN];
+    int32_t      max_token;
+    template_t * t;
+    int32_t      max_pane_alloced;
+} parse_t;
+
+//
+// variables
+//
+
+//
+// prototypes
+//
+
+static int32_t parse_line(parse_t * ps);
+static int32_t parse_node(parse_t * ps, double x, double y, double w, double h, 
+                          int32_t pad, int32_t depth);
+static int32_t parse_split(parse_t * ps, double x, double y, double w, double h, 
+                           int32_t pad, int32_t depth);
+static int32_t parse_grid(parse_t * ps, double x, double y, double w, double h, int32_t pad);
+static int32_t parse_pad_option(parse_t * ps, int32_t first, int32_t * pad);
+static int32_t parse_int(char * s, int32_t min, int32_t max, int32_t * val);
+static int32_t parse_double(char * s, double min, double max, double * val);
+static int32_t add_pane(parse_t * ps, double x, double y, double w, double h, int32_t pad);
+
+// -----------------  TEMPLATE API  --------------------------------------------
+
+int32_t template_read(char * file_name, template_t * t)
+{
+    parse_t ps;
+    double  x, y, w, h;
+    int32_t pad = 0, ret = -1;
+
+    // init 
+    memset(t, 0, sizeof(template_t));
+    memset(&ps, 0, sizeof(ps));
+    ps.file_name = file_name;
+    ps.t = t;
+
+    // open
+    ps.fp = fopen(file_name, "re");
+    if (ps.fp == NULL) {
+        ERROR("fopen %s, %s\n", file_name, strerror(errno));
+        return -1;
+    }
+
+    // parse the top level statements
+    while (parse_line(&ps) == 0) {
+        if (strcmp(ps.token[0], "SIZE") == 0) {
+            if (ps.max_token != 3 ||
+                parse_int(ps.token[1], 1, 100000, &t->width) != 0 ||
+                parse_int(ps.token[2], 1, 100000, &t->height) != 0)
+            {
+                ERROR("%s line %d: expected 'SIZE w h'\n", file_name, ps.line_num);
+                goto done;
+            }
+        } else if (strcmp(ps.token[0], "PAD") == 0) {
+            if (ps.max_token != 2 ||
+                parse_int(ps.token[1], 0, MAX_TEMPLATE_PAD, &pad) != 0)
+            {
+                ERROR("%s line %d: expected 'PAD n'\n", file_name, ps.line_num);
+                goto done;
+            }
+        } else if (strcmp(ps.token[0], "REGION") == 0) {
+            if (ps.max_token != 5 ||
+                parse_double(ps.token[1], 0, 100, &x) != 0 ||
+                parse_double(ps.token[2], 0, 100, &y) != 0 ||
+                parse_double(ps.token[3], 0, 100, &w) != 0 ||
+                parse_double(ps.token[4], 0, 100, &h) != 0 ||
+                w == 0 || h == 0 || x + w > 100 || y + h > 100)
+            {
+                ERROR("%s line %d: expected 'REGION x y w h', in percent of the window\n", 
+                      file_name, ps.line_num);
+                goto done;
+            }
+            if (parse_line(&ps) != 0) {
+                ERROR("%s: unexpected end of file after REGION\n", file_name);
+                goto done;
+            }
+            if (parse_node(&ps, x/100, y/100, w/100, h/100, pad, 0) != 0) {
+                goto done;
+            }
+        } else {
+            if (parse_node(&ps, 0, 0, 1, 1, pad, 0) != 0) {
+                goto done;
+            }
+        }
+    }
+
+    // error if the template has no image regions
+    if (t->max_pane == 0) {
+        ERROR("%s: no image regions\n", file_name);
+        goto done;
+    }
+
+    // success
+    ret = 0;
+
+done:
+    fclose(ps.fp);
+    if (ret != 0) {
+        template_free(t);
+    }
+    return ret;
+}
+
+void template_free(template_t * t)
+{
+    free(t->pane);
+    memset(t, 0, sizeof(template_t));
+}
+
+void template_get_panes(template_t * t, int32_t win_width, int32_t win_height, 
+                        int32_t max_rect, rect_t * rect)
+{
+    int32_t i, x0, x1, y0, y1;
+    template_pane_t * p;
+
+    for (i = 0; i < t->max_pane && i < max_rect; i++) {
+        p = &t->pane[i];
+
+        // the edges are rounded, rather than the size, so that panes which 
+        // share an edge in the template also share it in the window
+        x0 = lround(p->x * win_width);
+        x1 = lround((p->x + p->w) * win_width);
+        y0 = lround(p->y * win_height);
+        y1 = lround((p->y + p->h) * win_height);
+
+        rect[i].x = x0 + p->pad;
+        rect[i].y = y0 + p->pad;
+        rect[i].w = x1 - x0 - 2 * p->pad;
+        rect[i].h = y1 - y0 - 2 * p->pad;
+        if (rect[i].w < 1) rect[i].w = 1;
+        if (rect[i].h < 1) rect[i].h = 1;
+    }
+}
+
+// -----------------  PARSER  --------------------------------------------------
+
+// read the next line that is not blank, and split it into tokens;
+// returns -1 at end of file
+static int32_t parse_line(parse_t * ps)
+{
+    char * s, * saveptr;
+
+    while (fgets(ps->line, sizeof(ps->line), ps->fp) != NULL) {
+        ps->line_num++;
+        if ((s = strchr(ps->line, '#')) != NULL) {
+            *s = '\0';
+        }
+
+        ps->max_token = 0;
+        s = strtok_r(ps->line, " \t\r\n", &saveptr);
+        while (s != NULL && ps->max_token < MAX_TEMPLATE_TOKEN) {
+            ps->token[ps->max_token++] = s;
+            s = strtok_r(NULL, " \t\r\n", &saveptr);
+        }
+
+        if (ps->max_token > 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// parse the node on the current line, which fills the region x,y,w,h
+static int32_t parse_node(parse_t * ps, double x, double y, double w, double h, 
+                          int32_t pad, int32_t depth)
+{
+    if (depth >= MAX_TEMPLATE_DEPTH) {
+        ERROR("%s line %d: nested too deeply\n", ps->file_name, ps->line_num);
+        return -1;
+    }
+
+    if (strcmp(ps->token[0], "IMAGE") == 0) {
+        if (parse_pad_option(ps, 1, &pad) != 0) {
+            return -1;
+        }
+        return add_pane(ps, x, y, w, h, pad);
+    } else if (strcmp(ps->token[0], "SPLIT") == 0) {
+        return parse_split(ps, x, y, w, h, pad, depth);
+    } else if (strcmp(ps->token[0], "GRID") == 0) {
+        return parse_grid(ps, x, y, w, h, pad);
+    } else {
+        ERROR("%s line %d: unexpected '%s'\n", ps->file_name, ps->line_num, ps->token[0]);
+        return -1;
+    }
+}
+
+static int32_t parse_split(parse_t * ps, double x, double y, double w, double h, 
+                           int32_t pad, int32_t depth)
+{
+    double  weight[MAX_TEMPLATE_TOKEN];
+    double  sum, offset, part;
+    int32_t i, max_weight, line_num;
+    bool    horizontal;
+
+    // parse 'SPLIT H|V w1 w2 ... [PAD n]'
+    line_num = ps->line_num;
+    if (ps->max_token < 3 ||
+        (strcmp(ps->token[1], "H") != 0 && strcmp(ps->token[1], "V") != 0))
+    {
+        ERROR("%s line %d: expected 'SPLIT H|V w1 w2 ...'\n", ps->file_name, line_num);
+        return -1;
+    }
+    horizontal = (ps->token[1][0] == 'H');
+
+    max_weight = 0;
+    sum = 0;
+    for (i = 2; i < ps->max_token && strcmp(ps->token[i], "PAD") != 0; i++) {
+        if (parse_double(ps->token[i], 0, 1e6, &weight[max_weight]) != 0 ||
+            weight[max_weight] == 0)
+        {
+            ERROR("%s line %d: invalid weight '%s'\n", ps->file_name, line_num, ps->token[i]);
+            return -1;
+        }
+        sum += weight[max_weight++];
+    }
+    if (max_weight == 0) {
+        ERROR("%s line %d: expected 'SPLIT H|V w1 w2 ...'\n", ps->file_name, line_num);
+        return -1;
+    }
+    if (parse_pad_option(ps, i, &pad) != 0) {
+        return -1;
+    }
+
+    // parse the node that fills each part
+    offset = 0;
+    for (i = 0; i < max_weight; i++) {
+        if (parse_line(ps) != 0) {
+            ERROR("%s: unexpected end of file, SPLIT at line %d has %d parts\n", 
+                  ps->file_name, line_num, max_weight);
+            return -1;
+        }
+        part = weight[i] / sum;
+        if (horizontal) {
+            if (parse_node(ps, x + offset * w, y, part * w, h, pad, depth+1) != 0) {
+                return -1;
+            }
+        } else {
+            if (parse_node(ps, x, y + offset * h, w, part * h, pad, depth+1) != 0) {
+                return -1;
+            }
+        }
+        offset += part;
+    }
+
+    // parse 'END'
+    if (parse_line(ps) != 0 || ps->max_token != 1 || strcmp(ps->token[0], "END") != 0) {
+        ERROR("%s: expected END for the SPLIT at line %d\n", ps->file_name, line_num);
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t parse_grid(parse_t * ps, double x, double y, double w, double h, int32_t pad)
+{
+    int32_t cols, rows, c, r, span_c, span_r, span_cols, span_rows, span_pad, line_num;
+    int32_t max_span = 0, ret = -1;
+    bool  * used = NULL;
+
+    // parse 'GRID cols rows [PAD n]'
+    line_num = ps->line_num;
+    if (ps->max_token < 3 ||
+        parse_int(ps->token[1], 1, MAX_TEMPLATE_CELL, &cols) != 0 ||
+        parse_int(ps->token[2], 1, MAX_TEMPLATE_CELL, &rows) != 0 ||
+        cols * rows > MAX_TEMPLATE_CELL)
+    {
+        ERROR("%s line %d: expected 'GRID cols rows', with at most %d cells\n", 
+              ps->file_name, line_num, MAX_TEMPLATE_CELL);
+        return -1;
+    }
+    if (parse_pad_option(ps, 3, &pad) != 0) {
+        return -1;
+    }
+
+    // the cells used by the spans, to check that the spans do not overlap
+    used = calloc(cols * rows, sizeof(bool));
+    if (used == NULL) {
+        ERROR("allocate grid cells failed, %dx%d\n", cols, rows);
+        return -1;
+    }
+
+    // parse 'SPAN col row cols rows [PAD n]' lines, until 'END'
+    while (true) {
+        if (parse_line(ps) != 0) {
+            ERROR("%s: expected END for the GRID at line %d\n", ps->file_name, line_num);
+            goto done;
+        }
+        if (strcmp(ps->token[0], "END") == 0 && ps->max_token == 1) {
+            break;
+        }
+        if (strcmp(ps->token[0], "SPAN") != 0 ||
+            ps->max_token < 5 ||
+            parse_int(ps->token[1], 0, cols-1, &span_c) != 0 ||
+            parse_int(ps->token[2], 0, rows-1, &span_r) != 0 ||
+            parse_int(ps->token[3], 1, cols - span_c, &span_cols) != 0 ||
+            parse_int(ps->token[4], 1, rows - span_r, &span_rows) != 0)
+        {
+            ERROR("%s line %d: expected 'SPAN col row cols rows' within the %dx%d grid, or END\n", 
+                  ps->file_name, ps->line_num, cols, rows);
+            goto done;
+        }
+        span_pad = pad;
+        if (parse_pad_option(ps, 5, &span_pad) != 0) {
+            goto done;
+        }
+
+        for (r = span_r; r < span_r + span_rows; r++) {
+            for (c = span_c; c < span_c + span_cols; c++) {
+                if (used[r * cols + c]) {
+                    ERROR("%s line %d: SPAN overlaps cell %d,%d\n", ps->file_name, ps->line_num, c, r);
+                    goto done;
+                }
+                used[r * cols + c] = true;
+            }
+        }
+
+        if (add_pane(ps, 
+                     x + w * span_c / cols, 
+                     y + h * span_r / rows, 
+                     w * span_cols / cols, 
+                     h * span_rows / rows, 
+                     span_pad) != 0)
+        {
+            goto done;
+        }
+        max_span++;
+    }
+
+    // if no spans were supplied, then each cell is an image region
+    if (max_span == 0) {
+        for (r = 0; r < rows; r++) {
+            for (c = 0; c < cols; c++) {
+                if (add_pane(ps, x + w * c / cols, y + h * r / rows, w / cols, h / rows, pad) != 0) {
+                    goto done;
+                }
+            }
+        }
+    }
+
+    // success
+    ret = 0;
+
+done:
+    free(used);
+    return ret;
+}
+
+// parse the optional 'PAD n' that starts at token first
+static int32_t parse_pad_option(parse_t * ps, int32_t first, int32_t * pad)
+{
+    if (first == ps->max_token) {
+        return 0;
+    }
+    if (ps->max_token != first + 2 ||
+        strcmp(ps->token[first], "PAD") != 0 ||
+        parse_int(ps->token[first+1], 0, MAX_TEMPLATE_PAD, pad) != 0)
+    {
+        ERROR("%s line %d: unexpected '%s', expected 'PAD n'\n", 
+              ps->file_name, ps->line_num, ps->token[first]);
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t parse_int(char * s, int32_t min, int32_t max, int32_t * val)
+{
+    char    c;
+
+    if (sscanf(s, "%d%c", val, &c) != 1 || *val < min || *val > max) {
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t parse_double(char * s, double min, double max, double * val)
+{
+    char    c;
+
+    if (sscanf(s, "%lf%c", val, &c) != 1 || !(*val >= min && *val <= max)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t add_pane(parse_t * ps, double x, double y, double w, double h, int32_t pad)
+{
+    template_t * t = ps->t;
+
+    if (t->max_pane == ps->max_pane_alloced) {
+        ps->max_pane_alloced = (ps->max_pane_alloced == 0 ? 64 : 2 * ps->max_pane_alloced);
+        t->pane = realloc(t->pane, ps->max_pane_alloced * sizeof(template_pane_t));
+        if (t->pane == NULL) {
+            ERROR("allocate template panes failed, %d\n", ps->max_pane_alloced);
+            return -1;
+        }
+    }
+
+    t->pane[t->max_pane].x = x;
+    t->pane[t->max_pane].y = y;
+    t->pane[t->max_pane].w = w;
+    t->pane[t->max_pane].h = h;
+    t->pane[t->max_pane].pad = pad;
+    t->max_pane++;
+    return 0;
+}
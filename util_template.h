@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2017 Steven Haid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __UTIL_TEMPLATE_H__
+#define __UTIL_TEMPLATE_H__
+
+//
+// A layout template is a text file, one statement per line; '#' starts a comment.
+// The regions of the template are assigned to the images in the order that they 
+// appear in the file.
+//
+//   SIZE w h                default window size, in pixels
+//   PAD n                   default padding, in pixels, for the regions that follow
+//   REGION x y w h          the node on the next line fills this fixed region of 
+//                           the window; x,y,w,h are in percent of the window
+//   node                    a node that is not preceded by REGION fills the window
+//
+// nodes:
+//   IMAGE [PAD n]           an image region
+//   SPLIT H|V w1 w2 ... [PAD n]
+//                           split horizontally (side by side) or vertically 
+//                           (stacked) in proportion to the weights; the nodes
+//                           on the following lines fill the parts, and then END
+//   GRID cols rows [PAD n]  a grid of cells, followed by SPAN lines and then END;
+//                           a GRID without SPAN lines has an image region per cell
+//   SPAN col row cols rows [PAD n]
+//                           an image region that spans cells of the grid, col and 
+//                           row are zero based
+//
+// The padding of an image region insets the image on each side. The padding given
+// on a SPLIT or GRID is the default for the regions within it.
+//
+
+typedef struct {
+    double  x;      // x,y,w,h are fractions of the window size
+    double  y;
+    double  w;
+    double  h;
+    int32_t pad;    // pixels
+} template_pane_t;
+
+typedef struct {
+    int32_t           width;        // from the SIZE statement, 0 if not supplied
+    int32_t           height;
+    int32_t           max_pane;
+    template_pane_t * pane;
+} template_t;
+
+// parse the template file and compile it into a table of panes;
+// returns -1 if the file could not be read or has an error
+int32_t template_read(char * file_name, template_t * t);
+void template_free(template_t * t);
+
+// determine the rectangles of the first max_rect panes for the window size; 
+// neighboring panes share their edge pixel coordinate, so the panes tile the 
+// window without gaps or overlap before padding
+void template_get_panes(template_t * t, int32_t win_width, int32_t win_height, 
+                        int32_t max_rect, rect_t * rect);
+
+#endif